@@ -0,0 +1,77 @@
+; Multi-byte arithmetic: 32-bit Fibonacci with addc, a 32-bit running
+; subtraction with subb, a 16x16->32 bit multiply with mul and a packed
+; BCD counter with da, all on little-endian numbers in internal RAM.
+        org 0
+start:  mov 40h,#1              ; 40h-43h: a
+        mov 44h,#1              ; 44h-47h: b
+fib:    mov r0,#40h             ; a += b
+        mov r1,#44h
+        mov r2,#4
+        clr c
+add4:   mov a,@r0
+        addc a,@r1
+        mov @r0,a
+        inc r0
+        inc r1
+        djnz r2,add4
+        mov r0,#40h             ; swap a and b
+        mov r1,#44h
+        mov r2,#4
+swap4:  mov a,@r0
+        xch a,@r1
+        mov @r0,a
+        inc r0
+        inc r1
+        djnz r2,swap4
+        mov r0,#50h             ; 50h-53h -= b
+        mov r1,#44h
+        mov r2,#4
+        clr c
+sub4:   mov a,@r0
+        subb a,@r1
+        mov @r0,a
+        inc r0
+        inc r1
+        djnz r2,sub4
+        mov a,40h               ; 58h-5bh = a.low16 * b.low16
+        mov b,44h
+        mul ab
+        mov 58h,a
+        mov 59h,b
+        mov a,41h
+        mov b,45h
+        mul ab
+        mov 5ah,a
+        mov 5bh,b
+        mov a,40h
+        mov b,45h
+        mul ab
+        add a,59h
+        mov 59h,a
+        mov a,b
+        addc a,5ah
+        mov 5ah,a
+        clr a
+        addc a,5bh
+        mov 5bh,a
+        mov a,41h
+        mov b,44h
+        mul ab
+        add a,59h
+        mov 59h,a
+        mov a,b
+        addc a,5ah
+        mov 5ah,a
+        clr a
+        addc a,5bh
+        mov 5bh,a
+        mov r0,#60h             ; 60h-63h: BCD counter += 1
+        mov r2,#4
+        setb c
+bcd:    mov a,@r0
+        addc a,#0
+        da a
+        mov @r0,a
+        inc r0
+        djnz r2,bcd
+        sjmp fib
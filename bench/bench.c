@@ -0,0 +1,253 @@
+/* 8051 emulator core
+ * Copyright 2006 Jari Komppa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining 
+ * a copy of this software and associated documentation files (the 
+ * "Software"), to deal in the Software without restriction, including 
+ * without limitation the rights to use, copy, modify, merge, publish, 
+ * distribute, sublicense, and/or sell copies of the Software, and to 
+ * permit persons to whom the Software is furnished to do so, subject 
+ * to the following conditions: 
+ *
+ * The above copyright notice and this permission notice shall be included 
+ * in all copies or substantial portions of the Software. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+ * IN THE SOFTWARE. 
+ *
+ * (i.e. the MIT License)
+ *
+ * bench.c
+ * Throughput benchmark: runs the workloads on each engine and reports
+ * the results as JSON
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "emu8051.h"
+
+#if defined(EM8051_DISPATCH_THREADED)
+#define DISPATCH "threaded"
+#elif defined(EM8051_DISPATCH_SWITCH)
+#define DISPATCH "switch"
+#else
+#define DISPATCH "table"
+#endif
+
+// Ways of running the core; the dispatch method the bench was built with
+// decides what "tick" and "run_cycles" use for each operation (the opcode
+// table, do_op() or the threaded interpreter)
+enum BENCH_ENGINE
+{
+    ENGINE_TICK,       // tick() in a loop
+    ENGINE_RUN,        // run_cycles(), no decode cache
+    ENGINE_DECODED,    // run_cycles() with the decode cache
+    ENGINE_JIT,        // run_cycles() with the decode cache and the JIT
+    ENGINE_COUNT
+};
+
+static const char *engine_names[ENGINE_COUNT] = { "tick", "run_cycles", "decoded", "jit" };
+
+struct result
+{
+    double mSeconds; // best of the repeats
+    uint64_t mCycles;
+    uint64_t mOperations;
+    uint32_t mState; // checksum of the memories at the end
+};
+
+// FNV-1a over the internal RAM, SFRs and the first page of external
+// data; all engines must end up with the same value
+static uint32_t checksum(struct em8051 *aCPU)
+{
+    uint32_t hash = 2166136261u;
+    int i;
+    for (i = 0; i < 128; i++)
+        hash = (hash ^ aCPU->mLowerData[i]) * 16777619u;
+    for (i = 0; i < 128; i++)
+        hash = (hash ^ aCPU->mUpperData[i]) * 16777619u;
+    for (i = 0; i < 128; i++)
+        hash = (hash ^ aCPU->mSFR[i]) * 16777619u;
+    for (i = 0; i < 256; i++)
+        hash = (hash ^ aCPU->mExtData[i]) * 16777619u;
+    return hash;
+}
+
+// Runs aFilename for aTicks ticks on aEngine; returns 1 if the file can't
+// be loaded, -1 if the engine isn't in this build
+static int run_engine(const char *aFilename, int aEngine, uint32_t aTicks, struct result *aResult)
+{
+    struct em8051 *emu = calloc(1, sizeof(struct em8051));
+    struct timespec start, end;
+    int ret = 0;
+
+    emu->mCodeMemMaxIdx = 0xffff;
+    emu->mCodeMem = calloc(65536, sizeof(unsigned char));
+    emu->mExtDataMaxIdx = 0xffff;
+    emu->mExtData = calloc(65536, sizeof(unsigned char));
+    emu->mUpperData = calloc(128, sizeof(unsigned char));
+    emu->mBreakpoint = -1;
+
+    reset(emu, 1);
+    if (aEngine >= ENGINE_DECODED)
+        decode_cache(emu, 1);
+    if (aEngine == ENGINE_JIT && !jit_mode(emu, JIT_ON))
+        ret = -1;
+    else
+    if (load_obj(emu, (char *)aFilename) != 0)
+        ret = 1;
+
+    if (ret == 0)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        if (aEngine == ENGINE_TICK)
+        {
+            uint32_t i;
+            for (i = 0; i < aTicks; i++)
+                tick(emu);
+        }
+        else
+        {
+            uint32_t left = aTicks;
+            while (left > 0)
+                left -= run_cycles(emu, left, NULL);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        aResult->mSeconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        aResult->mCycles = emu->mCycles;
+        aResult->mOperations = emu->mOperations;
+        aResult->mState = checksum(emu);
+    }
+
+    decode_cache(emu, 0);
+    free(emu->mCodeMem);
+    free(emu->mExtData);
+    free(emu->mUpperData);
+    free(emu);
+    return ret;
+}
+
+// "bench/crc16.hex" -> "crc16"
+static void workload_name(const char *aFilename, char *aName, int aSize)
+{
+    const char *base = strrchr(aFilename, '/');
+    int len;
+    base = base ? base + 1 : aFilename;
+    len = strcspn(base, ".");
+    if (len >= aSize)
+        len = aSize - 1;
+    memcpy(aName, base, len);
+    aName[len] = 0;
+}
+
+int main(int parc, char ** pars)
+{
+    uint32_t ticks = 2000000;
+    int repeat = 3;
+    int first = 1;
+    int mismatch = 0;
+    int files = 0;
+    int i, engine, r;
+
+    for (i = 1; i < parc; i++)
+    {
+        if (strncmp("-ticks=", pars[i], 7) == 0)
+            ticks = strtoul(pars[i]+7, NULL, 10);
+        else
+        if (strncmp("-repeat=", pars[i], 8) == 0)
+            repeat = atoi(pars[i]+8);
+        else
+        if (pars[i][0] == '-')
+            files = -1;
+        else
+        if (files >= 0)
+            files++;
+    }
+
+    if (files <= 0 || ticks == 0 || repeat <= 0)
+    {
+        fprintf(stderr, "Usage: bench [options] hexfile [hexfile ...]\n\n"
+            "Runs each Intel HEX file on every engine and prints the results as\n"
+            "JSON: emulated MHz (at 12 clocks per cycle) and host nanoseconds per\n"
+            "instruction, best of the repeats. Available options:\n\n"
+            "-ticks=value      Machine cycles to run each workload (default: 2000000)\n"
+            "-repeat=value     Runs per workload and engine (default: 3)\n\n"
+            "Exit code is 1 if the engines don't agree on the end state.\n");
+        return 2;
+    }
+
+    printf("{\n");
+    printf("  \"dispatch\": \"" DISPATCH "\",\n");
+#ifdef __VERSION__
+    printf("  \"compiler\": \"%s\",\n", __VERSION__);
+#endif
+    printf("  \"ticks\": %lu,\n", (unsigned long)ticks);
+    printf("  \"repeat\": %d,\n", repeat);
+    printf("  \"results\": [");
+
+    for (i = 1; i < parc; i++)
+    {
+        struct result reference = { 0 };
+        char name[64];
+
+        if (pars[i][0] == '-')
+            continue;
+        workload_name(pars[i], name, sizeof(name));
+
+        for (engine = 0; engine < ENGINE_COUNT; engine++)
+        {
+            struct result best, result;
+            double mhz, ns;
+            int ret = 0;
+
+            for (r = 0; r < repeat && ret == 0; r++)
+            {
+                ret = run_engine(pars[i], engine, ticks, &result);
+                if (ret == 0 && (r == 0 || result.mSeconds < best.mSeconds))
+                    best = result;
+            }
+            if (ret > 0)
+            {
+                fprintf(stderr, "File '%s' load failure\n", pars[i]);
+                return 2;
+            }
+            if (ret < 0)
+                continue;
+
+            if (engine == 0)
+            {
+                reference = best;
+            }
+            else
+            if (best.mState != reference.mState || best.mOperations != reference.mOperations)
+            {
+                fprintf(stderr, "%s: %s ended in a different state than %s\n",
+                    name, engine_names[engine], engine_names[0]);
+                mismatch = 1;
+            }
+
+            mhz = best.mSeconds > 0 ? best.mCycles * 12 / best.mSeconds / 1e6 : 0;
+            ns = best.mOperations ? best.mSeconds * 1e9 / best.mOperations : 0;
+            printf("%s\n    { \"workload\": \"%s\", \"engine\": \"%s\", \"cycles\": %llu, "
+                "\"instructions\": %llu, \"seconds\": %.6f, \"mhz\": %.2f, "
+                "\"ns_per_instruction\": %.2f, \"state\": \"%08x\" }",
+                first ? "" : ",", name, engine_names[engine],
+                (unsigned long long)best.mCycles, (unsigned long long)best.mOperations,
+                best.mSeconds, mhz, ns, (unsigned int)best.mState);
+            fprintf(stderr, "%-8s %-9s %-10s %9.2f MHz %8.2f ns/instruction\n",
+                DISPATCH, name, engine_names[engine], mhz, ns);
+            first = 0;
+        }
+    }
+    printf("\n  ]\n}\n");
+
+    return mismatch;
+}
@@ -0,0 +1,24 @@
+; Bit-banged serial transmit: sends a string on P1.0 forever, eight data
+; bits, start and stop bits timed with a short delay loop.
+        org 0
+start:  mov dptr,#text
+next:   clr a
+        movc a,@a+dptr
+        jz start
+        inc dptr
+        acall send
+        sjmp next
+send:   clr p1.0                ; start bit
+        acall delay
+        mov r2,#8
+bit:    rrc a
+        mov p1.0,c
+        acall delay
+        djnz r2,bit
+        setb p1.0               ; stop bit
+        acall delay
+        ret
+delay:  mov r3,#4
+dly:    djnz r3,dly
+        ret
+text:   db 48h,65h,6ch,6ch,6fh,2ch,20h,77h,6fh,72h,6ch,64h,21h,0dh,0ah,0
@@ -0,0 +1,337 @@
+/* 8051 emulator core
+ * Copyright 2006 Jari Komppa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining 
+ * a copy of this software and associated documentation files (the 
+ * "Software"), to deal in the Software without restriction, including 
+ * without limitation the rights to use, copy, modify, merge, publish, 
+ * distribute, sublicense, and/or sell copies of the Software, and to 
+ * permit persons to whom the Software is furnished to do so, subject 
+ * to the following conditions: 
+ *
+ * The above copyright notice and this permission notice shall be included 
+ * in all copies or substantial portions of the Software. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+ * IN THE SOFTWARE. 
+ *
+ * (i.e. the MIT License)
+ *
+ * check.c
+ * Runs each program on tick() and on the faster engines side by side,
+ * and checks that they go through the same states
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emu8051.h"
+
+// Engines checked against tick(), as in bench.c
+enum CHECK_ENGINE
+{
+    ENGINE_RUN,        // run_cycles(), no decode cache
+    ENGINE_DECODED,    // run_cycles() with the decode cache: blocks and loop skipping
+    ENGINE_JIT,        // as above, with the JIT
+    ENGINE_COUNT
+};
+
+static const char *engine_names[ENGINE_COUNT] = { "run_cycles", "decoded", "jit" };
+
+static uint32_t random_state;
+
+// xorshift, so the budgets are the same on every host
+static uint32_t random_next(void)
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+// Peripheral for the mapped runs: reads depend on the cycle count, so a read
+// made at the wrong time shows up in the state
+static uint8_t mmio_read(struct em8051 *aCPU, uint16_t aAddress)
+{
+    return (uint8_t)(aCPU->mCycles * 7 + aAddress);
+}
+
+static void mmio_write(struct em8051 *aCPU, uint16_t aAddress, uint8_t aValue)
+{
+    aCPU->mExtData[aAddress] = aValue ^ (uint8_t)aCPU->mCycles;
+}
+
+static void destroy(struct em8051 *aCPU)
+{
+    decode_cache(aCPU, 0);
+    free(aCPU->mCodeMem);
+    free(aCPU->mExtData);
+    free(aCPU->mUpperData);
+    free(aCPU);
+}
+
+// 8052 with all the memory, and with the peripheral on page 80h if aMapped;
+// NULL if the file can't be loaded or the engine isn't in this build
+// (*aMissing set)
+static struct em8051 *create(const char *aFilename, int aEngine, int aMapped, int *aMissing)
+{
+    struct em8051 *emu = calloc(1, sizeof(struct em8051));
+    if (!emu)
+        return NULL;
+    emu->mCodeMemMaxIdx = 0xffff;
+    emu->mCodeMem = calloc(65536, sizeof(unsigned char));
+    emu->mExtDataMaxIdx = 0xffff;
+    emu->mExtData = calloc(65536, sizeof(unsigned char));
+    emu->mUpperData = calloc(128, sizeof(unsigned char));
+    emu->mBreakpoint = -1;
+    if (!emu->mCodeMem || !emu->mExtData || !emu->mUpperData)
+    {
+        destroy(emu);
+        return NULL;
+    }
+
+    reset(emu, 1);
+    *aMissing = 0;
+    if (aEngine >= ENGINE_DECODED)
+        decode_cache(emu, 1);
+    if (aEngine == ENGINE_JIT && !jit_mode(emu, JIT_ON))
+    {
+        *aMissing = 1;
+        destroy(emu);
+        return NULL;
+    }
+    if (load_obj(emu, (char *)aFilename) != 0)
+    {
+        destroy(emu);
+        return NULL;
+    }
+    if (aMapped)
+        xdata_map(emu, 0x8000, 0x100, mmio_read, mmio_write);
+    return emu;
+}
+
+// Name of the first part of the state that differs, or NULL
+static const char *compare(struct em8051 *aA, struct em8051 *aB)
+{
+    if (aA->mPC != aB->mPC)
+        return "PC";
+    if (memcmp(aA->mSFR, aB->mSFR, 128))
+        return "SFRs";
+    if (memcmp(aA->mLowerData, aB->mLowerData, 128))
+        return "lower internal RAM";
+    if (memcmp(aA->mUpperData, aB->mUpperData, 128))
+        return "upper internal RAM";
+    if (memcmp(aA->mExtData, aB->mExtData, 65536))
+        return "external RAM";
+    if (aA->mInterruptActive != aB->mInterruptActive ||
+        memcmp(aA->int_a, aB->int_a, 2) ||
+        memcmp(aA->int_psw, aB->int_psw, 2) ||
+        memcmp(aA->int_sp, aB->int_sp, 2))
+        return "interrupt state";
+    if (aA->mOperations != aB->mOperations)
+        return "operation count";
+    return NULL;
+}
+
+// from single ticks to a few thousand
+static uint32_t random_budget(void)
+{
+    return (random_next() % 5 == 0) ? random_next() % 4000 + 1 : random_next() % 4 + 1;
+}
+
+// Runs the engine in random budgets until aUntil ticks, and aRef on tick()
+// alongside; name of the first part of the state that differs after a
+// budget, or NULL
+static const char *run_both(struct em8051 *aRef, struct em8051 *aCPU, uint64_t aUntil)
+{
+    const char *diff = NULL;
+    while (aCPU->mCycles < aUntil && !diff)
+    {
+        run_cycles(aCPU, random_budget(), NULL);
+        while (aRef->mCycles < aCPU->mCycles)
+            tick(aRef);
+        diff = compare(aRef, aCPU);
+    }
+    return diff;
+}
+
+// As run_both(), without a reference
+static void run_alone(struct em8051 *aCPU, uint64_t aUntil)
+{
+    while (aCPU->mCycles < aUntil)
+        run_cycles(aCPU, random_budget(), NULL);
+}
+
+// Runs the engine in random budgets and compares with tick() after each;
+// returns 0 if the states agree, 1 if not, -1 if the engine isn't in this
+// build and 2 on load failure
+static int check(const char *aFilename, int aEngine, int aMapped, uint32_t aTicks)
+{
+    struct em8051 *ref, *emu;
+    const char *diff;
+    int missing = 0;
+
+    emu = create(aFilename, aEngine, aMapped, &missing);
+    if (!emu)
+        return missing ? -1 : 2;
+    ref = create(aFilename, ENGINE_RUN, aMapped, &missing);
+    if (!ref)
+    {
+        destroy(emu);
+        return 2;
+    }
+
+    random_state = 2463534242u;
+    diff = run_both(ref, emu, aTicks);
+
+    if (diff)
+        fprintf(stderr, "%s: %s%s differs from tick() in %s at cycle %llu, PC %04X\n",
+            aFilename, engine_names[aEngine], aMapped ? " (mapped)" : "", diff,
+            (unsigned long long)emu->mCycles, ref->mPC);
+
+    destroy(ref);
+    destroy(emu);
+    return diff ? 1 : 0;
+}
+
+// Restores with the decode cache on: to an older snapshot after a newer one
+// was taken, then to one snapshot again and again as a test loop would,
+// each time checking the state against tick() and going on from there;
+// returns 0 if the states agree, 1 if not and 2 on load failure
+static int check_restore(const char *aFilename, int aMapped, uint32_t aTicks)
+{
+    struct em8051 *ref, *emu;
+    struct em8051snapshot *older, *newer, *baseline = NULL;
+    const char *diff = NULL;
+    const char *step = "restore to an older snapshot";
+    bool nomem;
+    int missing = 0;
+    int round;
+
+    emu = create(aFilename, ENGINE_DECODED, aMapped, &missing);
+    if (!emu)
+        return 2;
+    ref = create(aFilename, ENGINE_RUN, aMapped, &missing);
+    if (!ref)
+    {
+        destroy(emu);
+        return 2;
+    }
+
+    random_state = 2463534242u;
+    run_alone(emu, aTicks / 4);
+    older = em8051_snapshot(emu);
+    run_alone(emu, aTicks / 2);
+    newer = em8051_snapshot(emu);
+    run_alone(emu, aTicks * 3 / 4);
+    nomem = !older || !newer;
+    if (!nomem)
+    {
+        // pages written between the two aren't marked since the newer one
+        em8051_restore_dirty(emu, older);
+        while (ref->mCycles < emu->mCycles)
+            tick(ref);
+        diff = compare(ref, emu);
+        if (!diff)
+            diff = run_both(ref, emu, aTicks / 2);
+    }
+
+    if (!nomem && !diff)
+    {
+        step = "repeated restore";
+        baseline = em8051_snapshot(emu);
+        nomem = !baseline;
+    }
+    for (round = 0; round < 16 && !nomem && !diff; round++)
+    {
+        run_alone(emu, emu->mCycles + random_next() % (aTicks / 16 + 1));
+        em8051_restore_dirty(emu, baseline);
+        diff = compare(ref, emu);
+    }
+    if (!nomem && !diff)
+        diff = run_both(ref, emu, aTicks);
+
+    if (nomem)
+        fprintf(stderr, "%s: out of memory\n", aFilename);
+    if (diff)
+        fprintf(stderr, "%s: %s%s differs from tick() in %s at cycle %llu, PC %04X\n",
+            aFilename, step, aMapped ? " (mapped)" : "", diff,
+            (unsigned long long)emu->mCycles, ref->mPC);
+
+    if (older)
+        em8051_snapshot_free(older);
+    if (newer)
+        em8051_snapshot_free(newer);
+    if (baseline)
+        em8051_snapshot_free(baseline);
+    destroy(ref);
+    destroy(emu);
+    return (nomem || diff) ? 1 : 0;
+}
+
+int main(int parc, char ** pars)
+{
+    uint32_t ticks = 1000000;
+    int failed = 0;
+    int files = 0;
+    int i, engine, mapped;
+
+    for (i = 1; i < parc; i++)
+    {
+        if (strncmp("-ticks=", pars[i], 7) == 0)
+            ticks = strtoul(pars[i]+7, NULL, 10);
+        else
+        if (pars[i][0] == '-')
+            files = -1;
+        else
+        if (files >= 0)
+            files++;
+    }
+
+    if (files <= 0 || ticks == 0)
+    {
+        fprintf(stderr, "Usage: check [options] hexfile [hexfile ...]\n\n"
+            "Runs each Intel HEX file on tick() and on every other engine, in\n"
+            "random run_cycles() budgets, and compares the state after each.\n"
+            "Each file runs twice, the second time with a peripheral mapped on\n"
+            "external memory page 80h, and is also restored from snapshots as it\n"
+            "runs with the decode cache.\n"
+            "Available options:\n\n"
+            "-ticks=value      Machine cycles to run each file (default: 1000000)\n\n"
+            "Exit code is 1 if any engine goes its own way.\n");
+        return 2;
+    }
+
+    for (i = 1; i < parc; i++)
+    {
+        if (pars[i][0] == '-')
+            continue;
+        for (mapped = 0; mapped < 2; mapped++)
+        {
+            for (engine = 0; engine < ENGINE_COUNT; engine++)
+            {
+                int ret = check(pars[i], engine, mapped, ticks);
+                if (ret == 2)
+                {
+                    fprintf(stderr, "File '%s' load failure\n", pars[i]);
+                    return 2;
+                }
+                if (ret == 0)
+                    printf("%s: %s%s ok\n", pars[i], engine_names[engine], mapped ? " (mapped)" : "");
+                if (ret == 1)
+                    failed = 1;
+            }
+            if (check_restore(pars[i], mapped, ticks) == 0)
+                printf("%s: restore%s ok\n", pars[i], mapped ? " (mapped)" : "");
+            else
+                failed = 1;
+        }
+    }
+
+    return failed;
+}
@@ -0,0 +1,39 @@
+; CRC-16/CCITT and an additive checksum over the first 256 bytes of code
+; memory, bit by bit, again and again. Results in 30h-33h.
+        org 0
+start:  mov dptr,#0
+        mov r0,#0               ; 256 bytes
+        mov r6,#0ffh            ; crc high
+        mov r7,#0ffh            ; crc low
+        mov r4,#0               ; checksum
+byte:   clr a
+        movc a,@a+dptr
+        inc dptr
+        mov r3,a
+        add a,r4
+        mov r4,a
+        mov a,r3
+        xrl a,r6
+        mov r6,a
+        mov r5,#8
+bit:    clr c
+        mov a,r7
+        rlc a
+        mov r7,a
+        mov a,r6
+        rlc a
+        mov r6,a
+        jnc nox
+        mov a,r6
+        xrl a,#10h
+        mov r6,a
+        mov a,r7
+        xrl a,#21h
+        mov r7,a
+nox:    djnz r5,bit
+        djnz r0,byte
+        mov 30h,r6
+        mov 31h,r7
+        mov 32h,r4
+        inc 33h
+        sjmp start
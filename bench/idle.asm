@@ -0,0 +1,23 @@
+; Idle heavy: the cpu sleeps in idle mode and wakes up to a timer 0
+; interrupt every 4096 cycles to do a little work.
+        org 0
+        ljmp main
+        org 0bh
+        ljmp t0isr
+        org 30h
+main:   mov tmod,#01h           ; timer 0 mode 1
+        mov th0,#0f0h
+        mov tl0,#0
+        setb et0
+        setb ea
+        setb tr0
+loop:   orl pcon,#1
+        inc 30h
+        mov a,30h
+        add a,31h
+        mov 31h,a
+        sjmp loop
+t0isr:  mov th0,#0f0h
+        mov tl0,#0
+        inc 40h
+        reti
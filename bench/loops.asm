@@ -0,0 +1,43 @@
+; Busy-wait and delay loops, the kind run_cycles() skips through with the
+; decode cache on: jnb polling a timer flag, djnz delays on registers in
+; two banks and on internal RAM, and an sjmp $ left by an interrupt.
+        org 0
+        ljmp main
+        org 0bh
+        ljmp t0isr
+        org 30h
+main:   mov tmod,#21h           ; timer 1 mode 2, timer 0 mode 1
+        mov th1,#0
+        setb tr1
+loop:   clr tf1                 ; poll for the timer 1 overflow
+        jnb tf1,$
+        mov r7,#200             ; delay in bank 0
+        djnz r7,$
+        setb rs1                ; and in bank 2
+        mov r5,#90
+        djnz r5,$
+        clr rs1
+        mov 40h,#3              ; nested delay on internal RAM
+outer:  mov 41h,#150
+        djnz 41h,$
+        djnz 40h,outer
+        mov th0,#0ffh           ; wait in sjmp $ for timer 0
+        mov tl0,#0
+        setb et0
+        setb ea
+        setb tr0
+        sjmp $
+        inc 30h
+        sjmp loop
+t0isr:  clr tr0                 ; return past the sjmp $
+        clr ea
+        pop 33h
+        pop 32h
+        mov a,32h
+        add a,#2
+        mov 32h,a
+        clr a
+        addc a,33h
+        push 32h
+        push acc
+        reti
@@ -0,0 +1,45 @@
+; MOVX to a peripheral page: reads and writes through @DPTR to 8000h-80FFh,
+; which "make check" also runs with xdata_map() callbacks on that page,
+; mixed with plain operations and @Ri accesses to ordinary external RAM
+; so the mapped reads sit between operations that form blocks. A write to
+; ordinary external RAM moves on to the next page every 256 passes, so
+; different runs leave different pages dirty.
+        org 0
+        ljmp main
+        org 0bh
+        ljmp t0isr
+        org 30h
+main:   mov tmod,#02h           ; timer 0 mode 2 for a steady interrupt
+        mov th0,#0c0h
+        setb et0
+        setb ea
+        setb tr0
+        mov dptr,#8000h
+        mov r0,#0
+        mov 33h,#1
+loop:   movx a,@dptr            ; read the peripheral
+        add a,30h
+        mov 30h,a
+        rl a
+        xrl a,#5ah
+        movx @dptr,a            ; and write it back
+        inc dptr
+        mov dph,#80h
+        movx a,@r0              ; ordinary external RAM in page 0
+        add a,30h
+        movx @r0,a
+        mov dph,33h             ; the moving page
+        movx @dptr,a
+        mov dph,#80h
+        inc r0
+        cjne r0,#0,same
+        inc 33h
+        anl 33h,#7fh
+same:   movx a,@dptr            ; two reads in a row
+        mov r2,a
+        movx a,@dptr
+        xrl a,r2
+        mov 31h,a
+        sjmp loop
+t0isr:  inc 32h
+        reti
@@ -0,0 +1,39 @@
+; Interrupt heavy: timer 0 in auto-reload mode interrupts every 32 cycles
+; and timer 1 reloads itself every 128 cycles, while the main loop counts.
+        org 0
+        ljmp main
+        org 0bh
+        ljmp t0isr
+        org 1bh
+        ljmp t1isr
+        org 30h
+main:   mov tmod,#12h           ; timer 1 mode 1, timer 0 mode 2
+        mov th0,#0e0h
+        mov tl0,#0e0h
+        mov th1,#0ffh
+        mov tl1,#80h
+        setb et0
+        setb et1
+        setb ea
+        setb tr0
+        setb tr1
+loop:   inc 30h
+        mov a,30h
+        jnz loop
+        inc 31h
+        sjmp loop
+t0isr:  push acc
+        push psw
+        mov a,40h
+        add a,#1
+        mov 40h,a
+        clr a
+        addc a,41h
+        mov 41h,a
+        pop psw
+        pop acc
+        reti
+t1isr:  mov th1,#0ffh
+        mov tl1,#80h
+        inc 42h
+        reti
@@ -0,0 +1,35 @@
+; Bubble sort of 64 pseudo-random bytes in external data memory, refilled
+; from a linear congruential generator and sorted again, forever.
+; Rounds done in 31h.
+        org 0
+start:  mov r0,#0
+        mov r6,#64
+        mov a,30h               ; generator state
+fill:   mov b,#5                ; a = a * 5 + 17
+        mul ab
+        add a,#17
+        movx @r0,a
+        inc r0
+        djnz r6,fill
+        mov 30h,a
+        mov r7,#63              ; passes
+pass:   mov r0,#0
+        mov r1,#1
+        mov a,r7
+        mov r6,a                ; compares in this pass
+cmp:    movx a,@r0
+        mov r2,a
+        movx a,@r1
+        clr c
+        subb a,r2               ; borrow if @r1 < @r0
+        jnc next
+        add a,r2
+        movx @r0,a
+        mov a,r2
+        movx @r1,a
+next:   inc r0
+        inc r1
+        djnz r6,cmp
+        djnz r7,pass
+        inc 31h
+        sjmp start
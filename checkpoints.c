@@ -0,0 +1,308 @@
+/* 8051 emulator core
+ * Copyright 2006 Jari Komppa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining 
+ * a copy of this software and associated documentation files (the 
+ * "Software"), to deal in the Software without restriction, including 
+ * without limitation the rights to use, copy, modify, merge, publish, 
+ * distribute, sublicense, and/or sell copies of the Software, and to 
+ * permit persons to whom the Software is furnished to do so, subject 
+ * to the following conditions: 
+ *
+ * The above copyright notice and this permission notice shall be included 
+ * in all copies or substantial portions of the Software. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+ * IN THE SOFTWARE. 
+ *
+ * (i.e. the MIT License)
+ *
+ * checkpoints.c
+ * Running backwards through periodic checkpoints and replay
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "emu8051.h"
+
+// Ring slot of checkpoint aIndex, counting from the oldest
+static int slot(struct em8051checkpoints *aRing, int aIndex)
+{
+    return (aRing->mOldest + aIndex) % aRing->mSlots;
+}
+
+static uint64_t cycle_at(struct em8051checkpoints *aRing, int aIndex)
+{
+    return aRing->mSnapshots[slot(aRing, aIndex)]->mState.mCycles;
+}
+
+// Forget the logged values before aPosition. They are moved down in bulk,
+// once they make up half of the log.
+static void drop_input(struct em8051checkpoints *aRing, uint64_t aPosition)
+{
+    uint32_t drop = (uint32_t)(aPosition - aRing->mInputBase);
+    uint32_t used = (uint32_t)(aRing->mInputEnd - aRing->mInputBase);
+
+    if (drop == 0 || drop < used / 2)
+        return;
+    memmove(aRing->mInput, aRing->mInput + drop, used - drop);
+    aRing->mInputBase = aPosition;
+}
+
+static void log_input(struct em8051checkpoints *aRing, uint8_t aValue)
+{
+    uint32_t used = (uint32_t)(aRing->mInputEnd - aRing->mInputBase);
+
+    if (used == aRing->mInputSize)
+    {
+        uint32_t size = aRing->mInputSize ? aRing->mInputSize * 2 : 4096;
+        uint8_t *input = realloc(aRing->mInput, size);
+        if (!input)
+            return;
+        aRing->mInput = input;
+        aRing->mInputSize = size;
+    }
+    aRing->mInput[used] = aValue;
+    aRing->mInputEnd++;
+}
+
+// Next logged value while replaying; false if not replaying or the log
+// has run out
+static bool replay_input(struct em8051checkpoints *aRing, uint8_t *aValue)
+{
+    if (!aRing->mReplaying || aRing->mInputPos >= aRing->mInputEnd)
+        return false;
+    *aValue = aRing->mInput[aRing->mInputPos - aRing->mInputBase];
+    aRing->mInputPos++;
+    return true;
+}
+
+uint8_t checkpoints_sfrread(struct em8051 *aCPU, uint8_t aRegister)
+{
+    struct em8051checkpoints *ring = aCPU->mCheckpoints;
+    uint8_t value;
+
+    if (replay_input(ring, &value))
+        return value;
+    value = aCPU->sfrread[aRegister - 0x80](aCPU, aRegister);
+    if (!ring->mReplaying)
+        log_input(ring, value);
+    return value;
+}
+
+uint8_t checkpoints_xread(struct em8051 *aCPU, em8051xread aRead, uint16_t aAddress)
+{
+    struct em8051checkpoints *ring = aCPU->mCheckpoints;
+    uint8_t value;
+
+    if (replay_input(ring, &value))
+        return value;
+    value = aRead(aCPU, aAddress);
+    if (!ring->mReplaying)
+        log_input(ring, value);
+    return value;
+}
+
+// Returns false if out of memory; the next one is tried an interval later
+static bool take(struct em8051checkpoints *aRing, struct em8051 *aCPU)
+{
+    struct em8051snapshot *snapshot;
+    int index;
+
+    aRing->mNext = aCPU->mCycles + aRing->mInterval;
+    snapshot = em8051_snapshot(aCPU);
+    if (!snapshot)
+        return false;
+
+    if (aRing->mCount == aRing->mSlots)
+    {
+        // the oldest one goes, and the inputs only it needed
+        em8051_snapshot_free(aRing->mSnapshots[aRing->mOldest]);
+        aRing->mOldest = (aRing->mOldest + 1) % aRing->mSlots;
+        aRing->mCount--;
+        drop_input(aRing, aRing->mCount ? aRing->mInputAt[aRing->mOldest] : aRing->mInputEnd);
+    }
+    index = slot(aRing, aRing->mCount);
+    aRing->mSnapshots[index] = snapshot;
+    aRing->mInputAt[index] = aRing->mInputEnd;
+    aRing->mCount++;
+    return true;
+}
+
+bool checkpoints_init(struct em8051checkpoints *aRing, struct em8051 *aCPU, int aCount, uint32_t aInterval)
+{
+    memset(aRing, 0, sizeof(struct em8051checkpoints));
+    if (aCount < 1)
+        aCount = 1;
+    aRing->mSnapshots = calloc(aCount, sizeof(struct em8051snapshot *));
+    aRing->mInputAt = calloc(aCount, sizeof(uint64_t));
+    if (!aRing->mSnapshots || !aRing->mInputAt)
+    {
+        free(aRing->mSnapshots);
+        free(aRing->mInputAt);
+        return false;
+    }
+    aRing->mSlots = aCount;
+    aRing->mInterval = aInterval ? aInterval : 1;
+    aCPU->mCheckpoints = aRing;
+    if (!take(aRing, aCPU))
+    {
+        checkpoints_free(aRing, aCPU);
+        return false;
+    }
+    return true;
+}
+
+void checkpoints_clear(struct em8051checkpoints *aRing, struct em8051 *aCPU)
+{
+    int i;
+
+    for (i = 0; i < aRing->mCount; i++)
+        em8051_snapshot_free(aRing->mSnapshots[slot(aRing, i)]);
+    aRing->mCount = 0;
+    aRing->mOldest = 0;
+    aRing->mInputBase = 0;
+    aRing->mInputEnd = 0;
+    aRing->mInputPos = 0;
+    take(aRing, aCPU);
+}
+
+void checkpoints_free(struct em8051checkpoints *aRing, struct em8051 *aCPU)
+{
+    int i;
+
+    for (i = 0; i < aRing->mCount; i++)
+        em8051_snapshot_free(aRing->mSnapshots[slot(aRing, i)]);
+    free(aRing->mSnapshots);
+    free(aRing->mInputAt);
+    free(aRing->mInput);
+    memset(aRing, 0, sizeof(struct em8051checkpoints));
+    aCPU->mCheckpoints = NULL;
+}
+
+uint32_t checkpoints_run(struct em8051checkpoints *aRing, struct em8051 *aCPU, uint32_t aBudget, int *aStopReason)
+{
+    uint32_t cycles = 0;
+    int stop = STOP_BUDGET;
+
+    while (cycles < aBudget && stop == STOP_BUDGET)
+    {
+        uint32_t slice = aBudget - cycles;
+        if (aCPU->mCycles >= aRing->mNext)
+            take(aRing, aCPU);
+        if (aRing->mNext - aCPU->mCycles < slice)
+            slice = (uint32_t)(aRing->mNext - aCPU->mCycles);
+        cycles += run_cycles(aCPU, slice, &stop);
+    }
+
+    if (aStopReason)
+        *aStopReason = stop;
+    return cycles;
+}
+
+// Restores checkpoint aIndex and runs forward to tick aCycle on the logged
+// inputs, with aTrace as the trace callback, and the breakpoint and
+// exceptions off
+static void replay(struct em8051checkpoints *aRing, struct em8051 *aCPU, int aIndex, uint64_t aCycle, em8051trace aTrace)
+{
+    em8051trace trace = aCPU->trace;
+    em8051exception except = aCPU->except;
+    int breakpoint = aCPU->mBreakpoint;
+    int index = slot(aRing, aIndex);
+
+    em8051_restore(aCPU, aRing->mSnapshots[index]);
+    aRing->mInputPos = aRing->mInputAt[index];
+    aRing->mReplaying = true;
+    aCPU->trace = aTrace;
+    aCPU->except = NULL;
+    aCPU->mBreakpoint = -1;
+
+    while (aCPU->mCycles < aCycle)
+    {
+        uint64_t left = aCycle - aCPU->mCycles;
+        run_cycles(aCPU, left > 0x40000000 ? 0x40000000 : (uint32_t)left, NULL);
+    }
+
+    aCPU->trace = trace;
+    aCPU->except = except;
+    aCPU->mBreakpoint = breakpoint;
+    aRing->mReplaying = false;
+}
+
+// Trace callback while searching: remembers the last operation at mFindPC
+static void find_trace(struct em8051 *aCPU, uint16_t aPC, uint8_t aTicks)
+{
+    struct em8051checkpoints *ring = aCPU->mCheckpoints;
+
+    if (ring->mFindPC < 0 || aPC == ring->mFindPC)
+    {
+        ring->mFound = aCPU->mCycles - 1;
+        ring->mFoundOps = 0;
+    }
+    if (ring->mFoundOps >= 0)
+        ring->mFoundOps++;
+    ring->mOps++;
+}
+
+// Goes back to the start of the last operation at aPC (any if -1), looking
+// through one checkpoint interval at a time, newest first. Later
+// checkpoints and inputs belong to a future that is now gone.
+static int find_back(struct em8051checkpoints *aRing, struct em8051 *aCPU, int aPC)
+{
+    struct em8051snapshot *now = em8051_snapshot(aCPU);
+    uint64_t end = aCPU->mCycles;
+    int ops = 0;
+    int i;
+
+    // without it there's no way back if nothing is found
+    if (!now)
+        return 0;
+    aRing->mFindPC = aPC;
+    for (i = aRing->mCount - 1; i >= 0; i--)
+    {
+        uint64_t start = cycle_at(aRing, i);
+        if (start >= end)
+            continue;
+
+        aRing->mFoundOps = -1;
+        aRing->mOps = 0;
+        replay(aRing, aCPU, i, end, find_trace);
+        if (aRing->mFoundOps > 0)
+        {
+            ops += aRing->mFoundOps;
+            replay(aRing, aCPU, i, aRing->mFound, NULL);
+            while (cycle_at(aRing, aRing->mCount - 1) > aCPU->mCycles)
+            {
+                em8051_snapshot_free(aRing->mSnapshots[slot(aRing, aRing->mCount - 1)]);
+                aRing->mCount--;
+            }
+            aRing->mInputEnd = aRing->mInputPos;
+            aRing->mNext = cycle_at(aRing, aRing->mCount - 1) + aRing->mInterval;
+            em8051_snapshot_free(now);
+            return ops;
+        }
+        ops += aRing->mOps;
+        end = start;
+    }
+
+    em8051_restore(aCPU, now);
+    em8051_snapshot_free(now);
+    return 0;
+}
+
+int checkpoints_step_back(struct em8051checkpoints *aRing, struct em8051 *aCPU)
+{
+    return find_back(aRing, aCPU, -1);
+}
+
+int checkpoints_reverse_continue(struct em8051checkpoints *aRing, struct em8051 *aCPU)
+{
+    if (aCPU->mBreakpoint < 0)
+        return 0;
+    return find_back(aRing, aCPU, aCPU->mBreakpoint);
+}
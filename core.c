@@ -28,6 +28,7 @@
 
 #define T0_MODE3_MASK (TMODMASK_M0_0 | TMODMASK_M1_0)
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "emu8051.h"
@@ -53,8 +54,10 @@ static void serial_tx(struct em8051 *aCPU) {
 }
 
 
-static void timer_tick(struct em8051 *aCPU)
+void timer_tick(struct em8051 *aCPU)
 {
+    uint8_t tcon = aCPU->mSFR[REG_TCON];
+    bool serial_trigger = aCPU->serial_interrupt_trigger;
     uint8_t increment;
     uint16_t v;
 
@@ -304,112 +307,246 @@ static void timer_tick(struct em8051 *aCPU)
     }
 
     // TODO: serial port, timer2, other stuff
+
+    if (aCPU->mSFR[REG_TCON] != tcon || aCPU->serial_interrupt_trigger != serial_trigger)
+        interrupt_update(aCPU);
 }
 
-void handle_interrupts(struct em8051 *aCPU)
+// Number of ticks a timer can run before it overflows (or, for timer 1,
+// sends a serial bit); the ticks in between only increment the counters.
+static uint32_t timer_headroom(struct em8051 *aCPU, int aTimer)
 {
-    int16_t dest_ip = -1;
-    uint8_t hi = 0;
-    uint8_t lo = 0;
-
-    // can't interrupt high level
-    if (aCPU->mInterruptActive > 1) 
-        return;    
+    uint8_t tmod = aCPU->mSFR[REG_TMOD];
+    uint8_t tcon = aCPU->mSFR[REG_TCON];
+    uint32_t headroom = 0xffffffff;
+    uint32_t left;
 
-    if (aCPU->mSFR[REG_IE] & IEMASK_EA)
+    if (aTimer == 0)
     {
-        // Interrupts enabled
-        if (aCPU->mSFR[REG_IE] & IEMASK_EX0 && aCPU->mSFR[REG_TCON] & TCONMASK_IE0)
+        if ((tmod & (TMODMASK_GATE_0 | TMODMASK_CT_0)) || !(tcon & TCONMASK_TR0))
+            return headroom;
+
+        switch (tmod & (TMODMASK_M0_0 | TMODMASK_M1_0))
         {
-            // External int 0 
-            dest_ip = ISR_INT0;
-            if (aCPU->mSFR[REG_IP] & IPMASK_PX0)
-                hi = 1;
-            lo = 1;
+        case 0:
+            left = 0x2000 - ((aCPU->mSFR[REG_TH0] << 5) | (aCPU->mSFR[REG_TL0] & 0x1f));
+            break;
+        case TMODMASK_M0_0:
+            left = 0x10000 - ((aCPU->mSFR[REG_TH0] << 8) | aCPU->mSFR[REG_TL0]);
+            break;
+        default: // 8-bit auto-reload, or TL0 in mode 3
+            left = 0x100 - aCPU->mSFR[REG_TL0];
+            break;
         }
-        if (aCPU->mSFR[REG_IE] & IEMASK_ET0 && aCPU->mSFR[REG_TCON] & TCONMASK_TF0 && !hi)
-        {
-            // Timer/counter 0 
-            if (!lo)
-            {
-                dest_ip = ISR_TF0;
-                lo = 1;
-            }
-            if (aCPU->mSFR[REG_IP] & IPMASK_PT0)
-            {
-                hi = 1;
-                dest_ip = ISR_TF0;
-            }
-        }
-        if (aCPU->mSFR[REG_IE] & IEMASK_EX1 && aCPU->mSFR[REG_TCON] & TCONMASK_IE1 && !hi)
+        return left - 1;
+    }
+
+    if ((tmod & (TMODMASK_GATE_1 | TMODMASK_CT_1)) || !(tcon & TCONMASK_TR1))
+        return headroom;
+
+    // pending TF1 sends a serial bit on every tick
+    if ((tcon & TCONMASK_TF1) && (aCPU->mSFR[REG_SCON] & SCONMASK_SM1))
+        return 0;
+
+    // TH0 runs on timer 1's switch in mode 3
+    if ((tmod & T0_MODE3_MASK) == T0_MODE3_MASK)
+        headroom = 0x100 - aCPU->mSFR[REG_TH0] - 1;
+
+    switch (tmod & (TMODMASK_M0_1 | TMODMASK_M1_1))
+    {
+    case 0:
+        left = 0x2000 - ((aCPU->mSFR[REG_TH1] << 5) | (aCPU->mSFR[REG_TL1] & 0x1f));
+        break;
+    case TMODMASK_M0_1:
+        left = 0x10000 - ((aCPU->mSFR[REG_TH1] << 8) | aCPU->mSFR[REG_TL1]);
+        break;
+    case TMODMASK_M1_1:
+        left = 0x100 - aCPU->mSFR[REG_TL1];
+        break;
+    default: // disabled
+        return headroom;
+    }
+    if (left - 1 < headroom)
+        headroom = left - 1;
+    return headroom;
+}
+
+// Run the timers for a number of ticks that fits in both timers' headroom
+static void timer_advance(struct em8051 *aCPU, uint32_t aTicks)
+{
+    uint8_t tmod = aCPU->mSFR[REG_TMOD];
+    uint8_t tcon = aCPU->mSFR[REG_TCON];
+    bool run0 = !(tmod & (TMODMASK_GATE_0 | TMODMASK_CT_0)) && (tcon & TCONMASK_TR0);
+    bool run1 = !(tmod & (TMODMASK_GATE_1 | TMODMASK_CT_1)) && (tcon & TCONMASK_TR1);
+    uint16_t v;
+
+    if ((tmod & T0_MODE3_MASK) == T0_MODE3_MASK)
+    {
+        if (run0)
+            aCPU->mSFR[REG_TL0] += aTicks;
+        if (run1)
+            aCPU->mSFR[REG_TH0] += aTicks;
+    }
+    else if (run0)
+    {
+        switch (tmod & (TMODMASK_M0_0 | TMODMASK_M1_0))
         {
-            // External int 1 
-            if (!lo)
-            {
-                dest_ip = ISR_INT1;
-                lo = 1;
-            }
-            if (aCPU->mSFR[REG_IP] & IPMASK_PX1)
-            {
-                hi = 1;
-                dest_ip = ISR_INT1;
-            }
+        case 0:
+            v = ((aCPU->mSFR[REG_TH0] << 5) | (aCPU->mSFR[REG_TL0] & 0x1f)) + aTicks;
+            aCPU->mSFR[REG_TL0] = (aCPU->mSFR[REG_TL0] & ~0x1f) | (v & 0x1f);
+            aCPU->mSFR[REG_TH0] = v >> 5;
+            break;
+        case TMODMASK_M0_0:
+            v = ((aCPU->mSFR[REG_TH0] << 8) | aCPU->mSFR[REG_TL0]) + aTicks;
+            aCPU->mSFR[REG_TL0] = v & 0xff;
+            aCPU->mSFR[REG_TH0] = v >> 8;
+            break;
+        case TMODMASK_M1_0:
+            aCPU->mSFR[REG_TL0] += aTicks;
+            break;
         }
-        if (aCPU->mSFR[REG_IE] & IEMASK_ET1 && aCPU->mSFR[REG_TCON] & TCONMASK_TF1 && !hi)
+    }
+
+    if (run1)
+    {
+        switch (tmod & (TMODMASK_M0_1 | TMODMASK_M1_1))
         {
-            // Timer/counter 1 enabled
-            if (!lo)
-            {
-                dest_ip = ISR_TF1;
-                lo = 1;
-            }
-            if (aCPU->mSFR[REG_IP] & IPMASK_PT1)
-            {
-                hi = 1;
-                dest_ip = ISR_TF1;
-            }
+        case 0:
+            v = ((aCPU->mSFR[REG_TH1] << 5) | (aCPU->mSFR[REG_TL1] & 0x1f)) + aTicks;
+            aCPU->mSFR[REG_TL1] = (aCPU->mSFR[REG_TL1] & ~0x1f) | (v & 0x1f);
+            aCPU->mSFR[REG_TH1] = v >> 5;
+            break;
+        case TMODMASK_M0_1:
+            v = ((aCPU->mSFR[REG_TH1] << 8) | aCPU->mSFR[REG_TL1]) + aTicks;
+            aCPU->mSFR[REG_TL1] = v & 0xff;
+            aCPU->mSFR[REG_TH1] = v >> 8;
+            break;
+        case TMODMASK_M1_1:
+            aCPU->mSFR[REG_TL1] += aTicks;
+            break;
         }
-        if (aCPU->mSFR[REG_IE] & IEMASK_ES && aCPU->serial_interrupt_trigger && !hi)
+    }
+}
+
+// Further away than any timer event can be
+#define TIMER_NO_EVENT 0x200000000ULL
+
+// Work out the next event of each timer from the registers
+static void timer_schedule(struct em8051 *aCPU)
+{
+    int i;
+
+    aCPU->mNextEvent = ~(uint64_t)0;
+    for (i = 0; i < EVENT_COUNT; i++)
+    {
+        aCPU->mEvent[i] = aCPU->mTimerSync + timer_headroom(aCPU, i) + 1;
+        if (aCPU->mEvent[i] < aCPU->mNextEvent)
+            aCPU->mNextEvent = aCPU->mEvent[i];
+    }
+}
+
+void timer_sync(struct em8051 *aCPU)
+{
+    // jump from event to event
+    while (aCPU->mNextEvent <= aCPU->mCycles)
+    {
+        uint64_t event = aCPU->mNextEvent;
+        int i;
+
+        timer_advance(aCPU, (uint32_t)(event - 1 - aCPU->mTimerSync));
+        timer_tick(aCPU);
+        aCPU->mTimerSync = event;
+
+        // only the timers that were due have a new event; the others
+        // just count
+        aCPU->mNextEvent = ~(uint64_t)0;
+        for (i = 0; i < EVENT_COUNT; i++)
         {
-            // Serial port interrupt 
-            if (!lo)
-            {
-                dest_ip = ISR_SR;
-                lo = 1;
-            }
-            if (aCPU->mSFR[REG_IP] & IPMASK_PS)
-            {
-                hi = 1;
-                dest_ip = ISR_SR;
-            }
-            // TODO
+            if (aCPU->mEvent[i] == event)
+                aCPU->mEvent[i] = event + timer_headroom(aCPU, i) + 1;
+            if (aCPU->mEvent[i] < aCPU->mNextEvent)
+                aCPU->mNextEvent = aCPU->mEvent[i];
         }
+    }
+
+    timer_advance(aCPU, (uint32_t)(aCPU->mCycles - aCPU->mTimerSync));
+    aCPU->mTimerSync = aCPU->mCycles;
+}
+
+void timer_changed(struct em8051 *aCPU)
+{
+    int i;
+
+    timer_sync(aCPU);
+    // the new values may bring events closer; look again on the next tick
+    for (i = 0; i < EVENT_COUNT; i++)
+        aCPU->mEvent[i] = aCPU->mCycles + 1;
+    aCPU->mNextEvent = aCPU->mCycles + 1;
+}
+
+// Count one tick; the timers only run when an event is due
+static void timer_step(struct em8051 *aCPU)
+{
+    aCPU->mCycles++;
+    if (aCPU->mCycles >= aCPU->mNextEvent)
+        timer_sync(aCPU);
+}
+
+void interrupt_update(struct em8051 *aCPU)
+{
+    uint8_t tcon = aCPU->mSFR[REG_TCON];
+    // one bit per source, in IE (and IP) bit order: IE0 and IE1 are
+    // TCON bits 1 and 3, TF0 and TF1 bits 5 and 7
+    uint8_t raised = ((tcon >> 1) & (IEMASK_EX0 | IEMASK_EX1)) |
+                     ((tcon >> 4) & (IEMASK_ET0 | IEMASK_ET1)) |
+                     (aCPU->serial_interrupt_trigger ? IEMASK_ES : 0);
+
 #ifdef __8052__
-        if (aCPU->mSFR[REG_IE] & IEMASK_ET2 && !hi)
-        {
-            // Timer 2 (8052 only)
-            if (!lo)
-            {
-                dest_ip = ISR_SR;
-                lo = 1;
-            }
-            if (aCPU->mSFR[REG_IP] & IPMASK_PT2)
-            {
-                hi = 1;
-                dest_ip = ISR_SR;
-            }
-            // TODO
-        }
+    // TODO: timer 2 flags
+    raised |= IEMASK_ET2;
 #endif // __8052__
-    }
-    
-    // no interrupt
-    if (dest_ip == -1)
+
+    if (!(aCPU->mSFR[REG_IE] & IEMASK_EA))
+        raised = 0;
+    raised &= aCPU->mSFR[REG_IE];
+    aCPU->mInterruptPending = raised | ((raised & aCPU->mSFR[REG_IP]) << 8);
+}
+
+// Pending interrupts that can be served at each mInterruptActive level
+static const uint16_t interrupt_level_mask[4] =
+{
+    0xffff, // nothing running; anything
+    0xff00, // low priority running; high priority only
+    0x0000, // high priority running; nothing
+    0x0000
+};
+
+// Vector of each interrupt source, in IE bit order
+static const uint8_t interrupt_vector[6] =
+{
+    ISR_INT0, ISR_TF0, ISR_INT1, ISR_TF1, ISR_SR,
+    ISR_SR // TODO: timer 2 (8052 only)
+};
+
+void handle_interrupts(struct em8051 *aCPU)
+{
+    uint8_t dest_ip;
+    uint8_t hi = 0;
+    uint8_t pending;
+    int i;
+
+    if (!(aCPU->mInterruptPending & interrupt_level_mask[aCPU->mInterruptActive & 3]))
         return;
 
-    // can't interrupt same-level
-    if (aCPU->mInterruptActive == 1 && !hi)
-        return; 
+    // high priority first, lowest bit (INT0) first within a level
+    pending = aCPU->mInterruptPending >> 8;
+    if (pending)
+        hi = 1;
+    else
+        pending = aCPU->mInterruptPending & 0xff;
+    for (i = 0; !(pending & (1 << i)); i++)
+        ;
+    dest_ip = interrupt_vector[i];
 
     // some interrupt occurs; perform LCALL
     aCPU->mSFR[REG_PCON] &= ~0x01; // clear idle flag, but not Power down flag
@@ -431,6 +568,7 @@ void handle_interrupts(struct em8051 *aCPU)
         aCPU->serial_interrupt_trigger = 0; // handled the serial interrupt trigger
         break;
     }
+    interrupt_update(aCPU);
 
     if (hi)
     {
@@ -441,14 +579,59 @@ void handle_interrupts(struct em8051 *aCPU)
         aCPU->mInterruptActive = 1;
     }
     aCPU->int_a[hi] = aCPU->mSFR[REG_ACC];
+    update_flags(aCPU);
+    update_parity(aCPU);
     aCPU->int_psw[hi] = aCPU->mSFR[REG_PSW];
     aCPU->int_sp[hi] = aCPU->mSFR[REG_SP];
 }
 
-bool tick(struct em8051 *aCPU)
+void update_parity(struct em8051 *aCPU)
+{
+    uint8_t v = aCPU->mSFR[REG_ACC];
+    v ^= v >> 4;
+    v &= 0xf;
+    v = (0x6996 >> v) & 1;
+    aCPU->mSFR[REG_PSW] = (aCPU->mSFR[REG_PSW] & ~PSWMASK_P) | (v * PSWMASK_P);
+}
+
+void update_flags(struct em8051 *aCPU)
+{
+    uint8_t value1 = aCPU->mFlagValue[0];
+    uint8_t value2 = aCPU->mFlagValue[1];
+    bool carryin = aCPU->mFlagCarry;
+    bool carry, auxcarry, overflow;
+
+    switch (aCPU->mFlagOp)
+    {
+    case FLAGS_ADD:
+        /* Carry: overflow from 7th bit to 8th bit */
+        carry = ((value1 & 255) + (value2 & 255) + carryin) >> 8;
+        /* Auxiliary carry: overflow from 3th bit to 4th bit */
+        auxcarry = ((value1 & 7) + (value2 & 7) + carryin) >> 3;
+        /* Overflow: overflow from 6th or 7th bit, but not both */
+        overflow = (((value1 & 127) + (value2 & 127) + carryin) >> 7)^carry;
+        break;
+    case FLAGS_SUB:
+        carry = (((value1 & 255) - (value2 & 255) - carryin) >> 8) & 1;
+        auxcarry = (((value1 & 7) - (value2 & 7) - carryin) >> 3) & 1;
+        overflow = ((((value1 & 127) - (value2 & 127) - carryin) >> 7) & 1)^carry;
+        break;
+    default:
+        return;
+    }
+
+    aCPU->mSFR[REG_PSW] = (aCPU->mSFR[REG_PSW] & ~(PSWMASK_C | PSWMASK_AC | PSWMASK_OV)) |
+          (carry << PSW_C) | (auxcarry << PSW_AC) | (overflow << PSW_OV);
+    aCPU->mFlagOp = FLAGS_NONE;
+}
+
+// tick(), but the timers are left for timer_sync() unless an event is due
+// With aEager the timers tick along with the cpu; otherwise they wait for
+// the next event
+static bool step(struct em8051 *aCPU, bool aEager)
 {
-    uint8_t v;
     bool ticked = false;
+    int i;
 
     if (aCPU->mTickDelay)
     {
@@ -458,6 +641,13 @@ bool tick(struct em8051 *aCPU)
     // Test for Power Down
     if (aCPU->mTickDelay == 0 && (aCPU->mSFR[REG_PCON]) & 0x02) {
         aCPU->mTickDelay = 1;
+        // the timers stand still, so their events move on by a tick
+        timer_sync(aCPU);
+        aCPU->mCycles++;
+        aCPU->mTimerSync++;
+        for (i = 0; i < EVENT_COUNT; i++)
+            aCPU->mEvent[i]++;
+        aCPU->mNextEvent++;
         return 1;
     }
 
@@ -476,23 +666,326 @@ bool tick(struct em8051 *aCPU)
         bool is_idle = (aCPU->mSFR[REG_PCON]) & 0x01;
         if (is_idle) {
             aCPU->mTickDelay = 1;
+        } else if (aCPU->mDecoded) {
+            struct em8051decoded *d = &aCPU->mDecoded[aCPU->mPC & (aCPU->mCodeMemMaxIdx)];
+            if (!d->op)
+                d = decode_operation(aCPU, aCPU->mPC);
+            aCPU->mTickDelay = d->op(aCPU);
         } else {
-            aCPU->mTickDelay = aCPU->op[aCPU->mCodeMem[aCPU->mPC & (aCPU->mCodeMemMaxIdx)]](aCPU);
+#ifdef EM8051_DISPATCH_SWITCH
+            aCPU->mTickDelay = aCPU->mCore->do_op(aCPU);
+#else
+            aCPU->mTickDelay = aCPU->mCore->op[aCPU->mCodeMem[aCPU->mPC & (aCPU->mCodeMemMaxIdx)]](aCPU);
+#endif
         }
         ticked = true;
-        // update parity bit
-        v = aCPU->mSFR[REG_ACC];
-        v ^= v >> 4;
-        v &= 0xf;
-        v = (0x6996 >> v) & 1;
-        aCPU->mSFR[REG_PSW] = (aCPU->mSFR[REG_PSW] & ~PSWMASK_P) | (v * PSWMASK_P);
+        if (!is_idle)
+            aCPU->mOperations++;
+        if (aCPU->mFlagOp != FLAGS_NONE)
+            update_flags(aCPU);
+        update_parity(aCPU);
+    }
+
+    if (aEager)
+    {
+        timer_tick(aCPU);
+        aCPU->mCycles++;
+        aCPU->mTimerSync = aCPU->mCycles;
+    }
+    else
+    {
+        timer_step(aCPU);
     }
 
-    timer_tick(aCPU);
+    return ticked;
+}
 
+bool tick(struct em8051 *aCPU)
+{
+    bool ticked;
+
+    // the timers tick every time, so there are no events to keep track
+    // of; run_cycles() schedules them again
+    aCPU->mNextEvent = aCPU->mCycles + TIMER_NO_EVENT;
+    // the host may have raised or enabled interrupts
+    interrupt_update(aCPU);
+    ticked = step(aCPU, true);
+    aCPU->mNextEvent = aCPU->mCycles + TIMER_NO_EVENT;
     return ticked;
 }
 
+static bool block_runnable(struct em8051 *aCPU, struct em8051decoded *aBlock, uint32_t aBudget)
+{
+    if (aBlock->block_ops == 0 || aBlock->block_ticks > aBudget)
+        return false;
+    // breakpoint on one of the operations after the first
+    if (aCPU->mBreakpoint >= 0 &&
+        (uint16_t)(aCPU->mBreakpoint - aCPU->mPC - 1) < aBlock->block_bytes - 1)
+        return false;
+    // no timer event inside the block
+    return aCPU->mCycles + aBlock->block_ticks < aCPU->mNextEvent;
+}
+
+uint8_t run_block_ops(struct em8051 *aCPU, struct em8051decoded *aBlock)
+{
+    uint8_t ops = aBlock->block_ops;
+    uint8_t delay = 0;
+
+    while (ops--)
+        delay = aCPU->mDecoded[aCPU->mPC & aCPU->mCodeMemMaxIdx].op(aCPU);
+    return delay;
+}
+
+// Run the operations of a block back to back. Blocks never touch timers,
+// interrupt control or callbacks, so the interrupt state can't change
+// inside one and no timer event falls inside one.
+static void run_block(struct em8051 *aCPU, struct em8051decoded *aBlock)
+{
+    uint8_t ticks = aBlock->block_ticks;
+    uint8_t delay;
+
+    if (!aCPU->mJit || !jit_run(aCPU, aBlock, &delay))
+        delay = run_block_ops(aCPU, aBlock);
+    aCPU->mOperations += aBlock->block_ops;
+
+    // as if the remaining ticks of the last operation had passed
+    aCPU->mTickDelay = delay ? 1 : 0;
+    aCPU->mCycles += ticks;
+}
+
+// Busy-wait or delay loop at PC, after the interrupts have been checked:
+// runs the iterations that end before the next timer event (and before
+// the counter runs out) in one step. Returns the ticks run, or 0.
+static uint32_t skip_loop(struct em8051 *aCPU, struct em8051decoded *aOp, uint32_t aBudget)
+{
+    uint64_t count = loop_count(aCPU, aOp);
+    uint64_t before_event;
+
+    if (!count)
+        return 0;
+    // an event on the last tick is seen at the next operation boundary
+    before_event = (aCPU->mNextEvent - aCPU->mCycles + aOp->ticks - 1) / aOp->ticks;
+    if (count > before_event)
+        count = before_event;
+    if (count > aBudget / aOp->ticks)
+        count = aBudget / aOp->ticks;
+    if (!count)
+        return 0;
+
+    loop_advance(aCPU, aOp, (uint32_t)count);
+    aCPU->mOperations += count;
+    aCPU->mTickDelay = 1;
+    aCPU->mCycles += count * aOp->ticks;
+    if (aCPU->mCycles >= aCPU->mNextEvent)
+        timer_sync(aCPU);
+    return (uint32_t)(count * aOp->ticks);
+}
+
+// Idle or power down at an operation boundary: nothing changes until the
+// next timer event, so skip straight to it. Returns the ticks run.
+static uint32_t run_idle(struct em8051 *aCPU, uint32_t aBudget)
+{
+    uint64_t ticks;
+    int i;
+
+    if (aCPU->mSFR[REG_PCON] & 0x02)
+    {
+        // power down; only a reset wakes the cpu, and the timers stand still
+        aCPU->mTickDelay = 1;
+        aCPU->mCycles += aBudget;
+        aCPU->mTimerSync += aBudget;
+        for (i = 0; i < EVENT_COUNT; i++)
+            aCPU->mEvent[i] += aBudget;
+        aCPU->mNextEvent += aBudget;
+        return aBudget;
+    }
+
+    // Operation boundary, as in tick()
+    aCPU->mTickDelay = 0;
+    handle_interrupts(aCPU);
+    if (aCPU->mTickDelay)
+    {
+        // interrupt call
+        timer_step(aCPU);
+        return 1;
+    }
+
+    // the interrupt state only changes on timer events
+    aCPU->mTickDelay = 1;
+    ticks = aCPU->mNextEvent - aCPU->mCycles;
+    if (ticks > aBudget)
+        ticks = aBudget;
+    aCPU->mCycles += ticks;
+    if (aCPU->mCycles >= aCPU->mNextEvent)
+        timer_sync(aCPU);
+    return (uint32_t)ticks;
+}
+
+uint32_t run_cycles(struct em8051 *aCPU, uint32_t aBudget, int *aStopReason)
+{
+    uint32_t cycles = 0;
+    int stop = STOP_BUDGET;
+
+    aCPU->mException = -1;
+    // the host may have changed the timer or interrupt registers
+    timer_schedule(aCPU);
+    interrupt_update(aCPU);
+
+    while (cycles < aBudget)
+    {
+        uint16_t pc;
+
+        // Operation still in progress; only the timers run
+        if (aCPU->mTickDelay > 1)
+        {
+            uint32_t ticks = aCPU->mTickDelay - 1;
+            if (ticks > aBudget - cycles)
+                ticks = aBudget - cycles;
+            aCPU->mTickDelay -= ticks;
+            aCPU->mCycles += ticks;
+            if (aCPU->mCycles >= aCPU->mNextEvent)
+                timer_sync(aCPU);
+            cycles += ticks;
+            continue;
+        }
+
+        pc = aCPU->mPC;
+        if ((aCPU->mSFR[REG_PCON] & 0x03) && !aCPU->trace && pc != aCPU->mBreakpoint)
+        {
+            cycles += run_idle(aCPU, aBudget - cycles);
+        }
+        else
+#ifdef EM8051_DISPATCH_THREADED
+        if (!aCPU->mDecoded && !(aCPU->mSFR[REG_PCON] & 0x03))
+        {
+            cycles += aCPU->mCore->run_threaded(aCPU, aBudget - cycles);
+        }
+        else
+#endif
+        if (aCPU->mDecoded && !aCPU->trace && !(aCPU->mSFR[REG_PCON] & 0x03))
+        {
+            // Operation boundary, as in tick()
+            aCPU->mTickDelay = 0;
+            handle_interrupts(aCPU);
+            if (aCPU->mTickDelay == 0)
+            {
+                struct em8051decoded *d = &aCPU->mDecoded[pc & aCPU->mCodeMemMaxIdx];
+                uint32_t ticks;
+                if (!d->op)
+                    d = decode_operation(aCPU, pc);
+                if (d->block_ops == BLOCK_UNKNOWN)
+                    decode_block(aCPU, pc);
+
+                if (d->loop && pc != aCPU->mBreakpoint &&
+                    (ticks = skip_loop(aCPU, d, aBudget - cycles)) != 0)
+                {
+                    cycles += ticks;
+                }
+                else if (block_runnable(aCPU, d, aBudget - cycles))
+                {
+                    cycles += d->block_ticks;
+                    run_block(aCPU, d);
+                }
+                else
+                {
+                    aCPU->mTickDelay = d->op(aCPU);
+                    aCPU->mOperations++;
+                    timer_step(aCPU);
+                    cycles++;
+                }
+            }
+            else
+            {
+                // interrupt call
+                timer_step(aCPU);
+                cycles++;
+            }
+        }
+        else
+        {
+            cycles++;
+            if (step(aCPU, false) && aCPU->trace)
+            {
+                timer_sync(aCPU);
+                aCPU->trace(aCPU, pc, aCPU->mTickDelay ? aCPU->mTickDelay : 1);
+            }
+        }
+
+        if (aCPU->mException != -1)
+        {
+            stop = STOP_EXCEPTION;
+            break;
+        }
+        if (aCPU->mPC == aCPU->mBreakpoint)
+        {
+            stop = STOP_BREAKPOINT;
+            break;
+        }
+    }
+
+    // flags and timers aren't kept up to date while running
+    update_flags(aCPU);
+    update_parity(aCPU);
+    timer_sync(aCPU);
+
+    if (aStopReason)
+        *aStopReason = stop;
+    return cycles;
+}
+
+void decode_cache(struct em8051 *aCPU, bool aEnable)
+{
+    if (aEnable == (aCPU->mDecoded != NULL))
+        return;
+    if (!aEnable)
+        jit_mode(aCPU, JIT_OFF);
+    free(aCPU->mDecoded);
+    aCPU->mDecoded = NULL;
+    if (aEnable)
+        aCPU->mDecoded = calloc(aCPU->mCodeMemMaxIdx + 1, sizeof(struct em8051decoded));
+}
+
+void invalidate_code(struct em8051 *aCPU, uint16_t aAddress, uint32_t aLength)
+{
+    uint32_t i;
+
+    if (!aCPU->mDecoded)
+        return;
+
+    if (aCPU->mJit)
+        jit_invalidate(aCPU, aAddress, aLength);
+
+    if (aLength > aCPU->mCodeMemMaxIdx)
+    {
+        memset(aCPU->mDecoded, 0, (aCPU->mCodeMemMaxIdx + 1) * sizeof(struct em8051decoded));
+        return;
+    }
+
+    // operations starting up to two bytes earlier cover the area too
+    for (i = 0; i < aLength + 2; i++)
+        aCPU->mDecoded[(aAddress - 2 + i) & aCPU->mCodeMemMaxIdx].op = NULL;
+
+    // and so do blocks starting before it
+    for (i = 1; i <= BLOCK_MAX_OPS * 3; i++)
+        aCPU->mDecoded[(aAddress - 2 - i) & aCPU->mCodeMemMaxIdx].block_ops = BLOCK_UNKNOWN;
+}
+
+void xdata_map(struct em8051 *aCPU, uint16_t aAddress, uint32_t aLength, em8051xread aRead, em8051xwrite aWrite)
+{
+    uint32_t page;
+
+    if (aLength == 0)
+        return;
+    for (page = aAddress >> 8; page <= ((aAddress + aLength - 1) >> 8) && page < 256; page++)
+    {
+        aCPU->xreadpage[page] = aRead;
+        aCPU->xwritepage[page] = aWrite;
+    }
+
+    // blocks and native code were built for the old map
+    invalidate_code(aCPU, 0, aCPU->mCodeMemMaxIdx + 1);
+}
+
 uint8_t decode(struct em8051 *aCPU, uint16_t aPosition, char *aBuffer)
 {
     bool is_idle = (aCPU->mSFR[REG_PCON]) & 0x01;
@@ -505,11 +998,21 @@ uint8_t decode(struct em8051 *aCPU, uint16_t aPosition, char *aBuffer)
         strcpy(aBuffer, "POWER DOWN");
         return 0;
     }
-    return aCPU->dec[aCPU->mCodeMem[aPosition & (aCPU->mCodeMemMaxIdx)]](aCPU, aPosition, aBuffer);
+    return dec_table[aCPU->mCodeMem[aPosition & (aCPU->mCodeMemMaxIdx)]](aCPU, aPosition, aBuffer);
 }
 
-void disasm_setptrs(struct em8051 *aCPU);
-void op_setptrs(struct em8051 *aCPU);
+// Handlers with the memory sizes built in, if there are ones for this
+// configuration
+static const struct em8051core *select_core(struct em8051 *aCPU)
+{
+    if (aCPU->mCodeMemMaxIdx == 0xffff && aCPU->mExtDataMaxIdx == 0xffff && aCPU->mUpperData)
+        return &core_ops_8052;
+    if (aCPU->mCodeMemMaxIdx == 0x0fff && !aCPU->mUpperData)
+        return &core_ops_8051;
+    if (aCPU->mCodeMemMaxIdx == 0x07ff && !aCPU->mUpperData)
+        return &core_ops_2051;
+    return &core_ops;
+}
 
 void reset(struct em8051 *aCPU, bool aWipe)
 {
@@ -517,11 +1020,13 @@ void reset(struct em8051 *aCPU, bool aWipe)
     if (aWipe)
     {
         memset(aCPU->mCodeMem, 0, aCPU->mCodeMemMaxIdx+1);
-        memset(aCPU->mExtData, 0, aCPU->mExtDataMaxIdx+1);
+        if (aCPU->mExtData)
+            memset(aCPU->mExtData, 0, aCPU->mExtDataMaxIdx+1);
         memset(aCPU->mLowerData, 0, 128);
         if (aCPU->mUpperData) 
             memset(aCPU->mUpperData, 0, 128);
     }
+    aCPU->mException = -1;
 
     memset(aCPU->mSFR, 0, 128);
 
@@ -539,19 +1044,94 @@ void reset(struct em8051 *aCPU, bool aWipe)
     if (aWipe)
         aCPU->mSFR[REG_PCON] |= (1<<4);
 
-    // Random values
-    if (aWipe)
-        aCPU->mSFR[REG_SBUF] = rand();
+    // SBUF is undefined after power on. It is left at zero: rand() would be
+    // shared by every instance (and thread) in the process, and runs would
+    // not repeat.
 
-    // build function pointer lists
-
-    disasm_setptrs(aCPU);
-    op_setptrs(aCPU);
+    // code memory may have been loaded since, and decoded operations point
+    // to the handlers of the old core
+    aCPU->mCore = select_core(aCPU);
+    invalidate_code(aCPU, 0, aCPU->mCodeMemMaxIdx + 1);
 
     // Clean internal variables
     aCPU->mInterruptActive = 0;
+    aCPU->mFlagOp = FLAGS_NONE;
+
+    // Clean timer events
+    aCPU->mCycles = 0;
+    aCPU->mOperations = 0;
+    aCPU->mTimerSync = 0;
+    timer_schedule(aCPU);
 
     // Clean Serial
     aCPU->serial_interrupt_trigger = 0;
     aCPU->serial_out_remaining_bits = 0;
+
+    interrupt_update(aCPU);
+}
+
+static int readbyte(FILE * f)
+{
+    char data[3];
+    data[0] = fgetc(f);
+    data[1] = fgetc(f);
+    data[2] = 0;
+    return strtol(data, NULL, 16);
+}
+
+int load_obj(struct em8051 *aCPU, char *aFilename)
+{
+    FILE *f;
+    int result = -5;
+    if (aFilename == 0 || aFilename[0] == 0)
+        return -1;
+    f = fopen(aFilename, "r");
+    if (!f) return -1;
+    if (fgetc(f) != ':')
+    {
+        fclose(f);
+        return -2; // unsupported file format
+    }
+    while (!feof(f))
+    {
+        int recordlength;
+        int address;
+        int recordtype;
+        int checksum;
+        int i;
+        recordlength = readbyte(f);
+        address = readbyte(f);
+        address <<= 8;
+        address |= readbyte(f);
+        recordtype = readbyte(f);
+        if (recordtype == 1)
+        {
+            result = 0; // we're done
+            break;
+        }
+        if (recordtype != 0)
+        {
+            result = -3; // unsupported record type
+            break;
+        }
+        checksum = recordtype + recordlength + (address & 0xff) + (address >> 8); // final checksum = 1 + not(checksum)
+        for (i = 0; i < recordlength; i++)
+        {
+            int data = readbyte(f);
+            checksum += data;
+            aCPU->mCodeMem[(address + i) & aCPU->mCodeMemMaxIdx] = data;
+        }
+        invalidate_code(aCPU, address, recordlength);
+        i = readbyte(f);
+        checksum &= 0xff;
+        checksum = 256 - checksum;
+        if (i != (checksum & 0xff))
+        {
+            result = -4; // checksum failure
+            break;
+        }
+        while (fgetc(f) != ':' && !feof(f)) {} // skip newline
+    }
+    fclose(f);
+    return result;
 }
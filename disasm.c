@@ -1090,169 +1090,71 @@ static uint8_t disasm_mov_rx_a(struct em8051 *aCPU, uint16_t aPosition, char *aB
     return 1;
 }
 
-void disasm_setptrs(struct em8051 *aCPU)
-{
-    int i;
-    for (i = 0; i < 8; i++)
-    {
-        aCPU->dec[0x08 + i] = &disasm_inc_rx;
-        aCPU->dec[0x18 + i] = &disasm_dec_rx;
-        aCPU->dec[0x28 + i] = &disasm_add_a_rx;
-        aCPU->dec[0x38 + i] = &disasm_addc_a_rx;
-        aCPU->dec[0x48 + i] = &disasm_orl_a_rx;
-        aCPU->dec[0x58 + i] = &disasm_anl_a_rx;
-        aCPU->dec[0x68 + i] = &disasm_xrl_a_rx;
-        aCPU->dec[0x78 + i] = &disasm_mov_rx_imm;
-        aCPU->dec[0x88 + i] = &disasm_mov_mem_rx;
-        aCPU->dec[0x98 + i] = &disasm_subb_a_rx;
-        aCPU->dec[0xa8 + i] = &disasm_mov_rx_mem;
-        aCPU->dec[0xb8 + i] = &disasm_cjne_rx_imm_offset;
-        aCPU->dec[0xc8 + i] = &disasm_xch_a_rx;
-        aCPU->dec[0xd8 + i] = &disasm_djnz_rx_offset;
-        aCPU->dec[0xe8 + i] = &disasm_mov_a_rx;
-        aCPU->dec[0xf8 + i] = &disasm_mov_rx_a;
-    }
-    aCPU->dec[0x00] = &disasm_nop;
-    aCPU->dec[0x01] = &disasm_ajmp_offset;
-    aCPU->dec[0x02] = &disasm_ljmp_address;
-    aCPU->dec[0x03] = &disasm_rr_a;
-    aCPU->dec[0x04] = &disasm_inc_a;
-    aCPU->dec[0x05] = &disasm_inc_mem;
-    aCPU->dec[0x06] = &disasm_inc_indir_rx;
-    aCPU->dec[0x07] = &disasm_inc_indir_rx;
-
-    aCPU->dec[0x10] = &disasm_jbc_bitaddr_offset;
-    aCPU->dec[0x11] = &disasm_acall_offset;
-    aCPU->dec[0x12] = &disasm_lcall_address;
-    aCPU->dec[0x13] = &disasm_rrc_a;
-    aCPU->dec[0x14] = &disasm_dec_a;
-    aCPU->dec[0x15] = &disasm_dec_mem;
-    aCPU->dec[0x16] = &disasm_dec_indir_rx;
-    aCPU->dec[0x17] = &disasm_dec_indir_rx;
-
-    aCPU->dec[0x20] = &disasm_jb_bitaddr_offset;
-    aCPU->dec[0x21] = &disasm_ajmp_offset;
-    aCPU->dec[0x22] = &disasm_ret;
-    aCPU->dec[0x23] = &disasm_rl_a;
-    aCPU->dec[0x24] = &disasm_add_a_imm;
-    aCPU->dec[0x25] = &disasm_add_a_mem;
-    aCPU->dec[0x26] = &disasm_add_a_indir_rx;
-    aCPU->dec[0x27] = &disasm_add_a_indir_rx;
-
-    aCPU->dec[0x30] = &disasm_jnb_bitaddr_offset;
-    aCPU->dec[0x31] = &disasm_acall_offset;
-    aCPU->dec[0x32] = &disasm_reti;
-    aCPU->dec[0x33] = &disasm_rlc_a;
-    aCPU->dec[0x34] = &disasm_addc_a_imm;
-    aCPU->dec[0x35] = &disasm_addc_a_mem;
-    aCPU->dec[0x36] = &disasm_addc_a_indir_rx;
-    aCPU->dec[0x37] = &disasm_addc_a_indir_rx;
-
-    aCPU->dec[0x40] = &disasm_jc_offset;
-    aCPU->dec[0x41] = &disasm_ajmp_offset;
-    aCPU->dec[0x42] = &disasm_orl_mem_a;
-    aCPU->dec[0x43] = &disasm_orl_mem_imm;
-    aCPU->dec[0x44] = &disasm_orl_a_imm;
-    aCPU->dec[0x45] = &disasm_orl_a_mem;
-    aCPU->dec[0x46] = &disasm_orl_a_indir_rx;
-    aCPU->dec[0x47] = &disasm_orl_a_indir_rx;
-
-    aCPU->dec[0x50] = &disasm_jnc_offset;
-    aCPU->dec[0x51] = &disasm_acall_offset;
-    aCPU->dec[0x52] = &disasm_anl_mem_a;
-    aCPU->dec[0x53] = &disasm_anl_mem_imm;
-    aCPU->dec[0x54] = &disasm_anl_a_imm;
-    aCPU->dec[0x55] = &disasm_anl_a_mem;
-    aCPU->dec[0x56] = &disasm_anl_a_indir_rx;
-    aCPU->dec[0x57] = &disasm_anl_a_indir_rx;
-
-    aCPU->dec[0x60] = &disasm_jz_offset;
-    aCPU->dec[0x61] = &disasm_ajmp_offset;
-    aCPU->dec[0x62] = &disasm_xrl_mem_a;
-    aCPU->dec[0x63] = &disasm_xrl_mem_imm;
-    aCPU->dec[0x64] = &disasm_xrl_a_imm;
-    aCPU->dec[0x65] = &disasm_xrl_a_mem;
-    aCPU->dec[0x66] = &disasm_xrl_a_indir_rx;
-    aCPU->dec[0x67] = &disasm_xrl_a_indir_rx;
-
-    aCPU->dec[0x70] = &disasm_jnz_offset;
-    aCPU->dec[0x71] = &disasm_acall_offset;
-    aCPU->dec[0x72] = &disasm_orl_c_bitaddr;
-    aCPU->dec[0x73] = &disasm_jmp_indir_a_dptr;
-    aCPU->dec[0x74] = &disasm_mov_a_imm;
-    aCPU->dec[0x75] = &disasm_mov_mem_imm;
-    aCPU->dec[0x76] = &disasm_mov_indir_rx_imm;
-    aCPU->dec[0x77] = &disasm_mov_indir_rx_imm;
-
-    aCPU->dec[0x80] = &disasm_sjmp_offset;
-    aCPU->dec[0x81] = &disasm_ajmp_offset;
-    aCPU->dec[0x82] = &disasm_anl_c_bitaddr;
-    aCPU->dec[0x83] = &disasm_movc_a_indir_a_pc;
-    aCPU->dec[0x84] = &disasm_div_ab;
-    aCPU->dec[0x85] = &disasm_mov_mem_mem;
-    aCPU->dec[0x86] = &disasm_mov_mem_indir_rx;
-    aCPU->dec[0x87] = &disasm_mov_mem_indir_rx;
-
-    aCPU->dec[0x90] = &disasm_mov_dptr_imm;
-    aCPU->dec[0x91] = &disasm_acall_offset;
-    aCPU->dec[0x92] = &disasm_mov_bitaddr_c;
-    aCPU->dec[0x93] = &disasm_movc_a_indir_a_dptr;
-    aCPU->dec[0x94] = &disasm_subb_a_imm;
-    aCPU->dec[0x95] = &disasm_subb_a_mem;
-    aCPU->dec[0x96] = &disasm_subb_a_indir_rx;
-    aCPU->dec[0x97] = &disasm_subb_a_indir_rx;
-
-    aCPU->dec[0xa0] = &disasm_orl_c_compl_bitaddr;
-    aCPU->dec[0xa1] = &disasm_ajmp_offset;
-    aCPU->dec[0xa2] = &disasm_mov_c_bitaddr;
-    aCPU->dec[0xa3] = &disasm_inc_dptr;
-    aCPU->dec[0xa4] = &disasm_mul_ab;
-    aCPU->dec[0xa5] = &disasm_nop; // unused
-    aCPU->dec[0xa6] = &disasm_mov_indir_rx_mem;
-    aCPU->dec[0xa7] = &disasm_mov_indir_rx_mem;
-
-    aCPU->dec[0xb0] = &disasm_anl_c_compl_bitaddr;
-    aCPU->dec[0xb1] = &disasm_acall_offset;
-    aCPU->dec[0xb2] = &disasm_cpl_bitaddr;
-    aCPU->dec[0xb3] = &disasm_cpl_c;
-    aCPU->dec[0xb4] = &disasm_cjne_a_imm_offset;
-    aCPU->dec[0xb5] = &disasm_cjne_a_mem_offset;
-    aCPU->dec[0xb6] = &disasm_cjne_indir_rx_imm_offset;
-    aCPU->dec[0xb7] = &disasm_cjne_indir_rx_imm_offset;
-
-    aCPU->dec[0xc0] = &disasm_push_mem;
-    aCPU->dec[0xc1] = &disasm_ajmp_offset;
-    aCPU->dec[0xc2] = &disasm_clr_bitaddr;
-    aCPU->dec[0xc3] = &disasm_clr_c;
-    aCPU->dec[0xc4] = &disasm_swap_a;
-    aCPU->dec[0xc5] = &disasm_xch_a_mem;
-    aCPU->dec[0xc6] = &disasm_xch_a_indir_rx;
-    aCPU->dec[0xc7] = &disasm_xch_a_indir_rx;
-
-    aCPU->dec[0xd0] = &disasm_pop_mem;
-    aCPU->dec[0xd1] = &disasm_acall_offset;
-    aCPU->dec[0xd2] = &disasm_setb_bitaddr;
-    aCPU->dec[0xd3] = &disasm_setb_c;
-    aCPU->dec[0xd4] = &disasm_da_a;
-    aCPU->dec[0xd5] = &disasm_djnz_mem_offset;
-    aCPU->dec[0xd6] = &disasm_xchd_a_indir_rx;
-    aCPU->dec[0xd7] = &disasm_xchd_a_indir_rx;
-
-    aCPU->dec[0xe0] = &disasm_movx_a_indir_dptr;
-    aCPU->dec[0xe1] = &disasm_ajmp_offset;
-    aCPU->dec[0xe2] = &disasm_movx_a_indir_rx;
-    aCPU->dec[0xe3] = &disasm_movx_a_indir_rx;
-    aCPU->dec[0xe4] = &disasm_clr_a;
-    aCPU->dec[0xe5] = &disasm_mov_a_mem;
-    aCPU->dec[0xe6] = &disasm_mov_a_indir_rx;
-    aCPU->dec[0xe7] = &disasm_mov_a_indir_rx;
-
-    aCPU->dec[0xf0] = &disasm_movx_indir_dptr_a;
-    aCPU->dec[0xf1] = &disasm_acall_offset;
-    aCPU->dec[0xf2] = &disasm_movx_indir_rx_a;
-    aCPU->dec[0xf3] = &disasm_movx_indir_rx_a;
-    aCPU->dec[0xf4] = &disasm_cpl_a;
-    aCPU->dec[0xf5] = &disasm_mov_mem_a;
-    aCPU->dec[0xf6] = &disasm_mov_indir_rx_a;
-    aCPU->dec[0xf7] = &disasm_mov_indir_rx_a;
-}
+// Opcode-to-string decoders, by opcode
+const em8051decoder dec_table[256] =
+{
+    &disasm_nop, &disasm_ajmp_offset, &disasm_ljmp_address, &disasm_rr_a, // 0x00
+    &disasm_inc_a, &disasm_inc_mem, &disasm_inc_indir_rx, &disasm_inc_indir_rx, // 0x04
+    &disasm_inc_rx, &disasm_inc_rx, &disasm_inc_rx, &disasm_inc_rx, // 0x08
+    &disasm_inc_rx, &disasm_inc_rx, &disasm_inc_rx, &disasm_inc_rx, // 0x0c
+    &disasm_jbc_bitaddr_offset, &disasm_acall_offset, &disasm_lcall_address, &disasm_rrc_a, // 0x10
+    &disasm_dec_a, &disasm_dec_mem, &disasm_dec_indir_rx, &disasm_dec_indir_rx, // 0x14
+    &disasm_dec_rx, &disasm_dec_rx, &disasm_dec_rx, &disasm_dec_rx, // 0x18
+    &disasm_dec_rx, &disasm_dec_rx, &disasm_dec_rx, &disasm_dec_rx, // 0x1c
+    &disasm_jb_bitaddr_offset, &disasm_ajmp_offset, &disasm_ret, &disasm_rl_a, // 0x20
+    &disasm_add_a_imm, &disasm_add_a_mem, &disasm_add_a_indir_rx, &disasm_add_a_indir_rx, // 0x24
+    &disasm_add_a_rx, &disasm_add_a_rx, &disasm_add_a_rx, &disasm_add_a_rx, // 0x28
+    &disasm_add_a_rx, &disasm_add_a_rx, &disasm_add_a_rx, &disasm_add_a_rx, // 0x2c
+    &disasm_jnb_bitaddr_offset, &disasm_acall_offset, &disasm_reti, &disasm_rlc_a, // 0x30
+    &disasm_addc_a_imm, &disasm_addc_a_mem, &disasm_addc_a_indir_rx, &disasm_addc_a_indir_rx, // 0x34
+    &disasm_addc_a_rx, &disasm_addc_a_rx, &disasm_addc_a_rx, &disasm_addc_a_rx, // 0x38
+    &disasm_addc_a_rx, &disasm_addc_a_rx, &disasm_addc_a_rx, &disasm_addc_a_rx, // 0x3c
+    &disasm_jc_offset, &disasm_ajmp_offset, &disasm_orl_mem_a, &disasm_orl_mem_imm, // 0x40
+    &disasm_orl_a_imm, &disasm_orl_a_mem, &disasm_orl_a_indir_rx, &disasm_orl_a_indir_rx, // 0x44
+    &disasm_orl_a_rx, &disasm_orl_a_rx, &disasm_orl_a_rx, &disasm_orl_a_rx, // 0x48
+    &disasm_orl_a_rx, &disasm_orl_a_rx, &disasm_orl_a_rx, &disasm_orl_a_rx, // 0x4c
+    &disasm_jnc_offset, &disasm_acall_offset, &disasm_anl_mem_a, &disasm_anl_mem_imm, // 0x50
+    &disasm_anl_a_imm, &disasm_anl_a_mem, &disasm_anl_a_indir_rx, &disasm_anl_a_indir_rx, // 0x54
+    &disasm_anl_a_rx, &disasm_anl_a_rx, &disasm_anl_a_rx, &disasm_anl_a_rx, // 0x58
+    &disasm_anl_a_rx, &disasm_anl_a_rx, &disasm_anl_a_rx, &disasm_anl_a_rx, // 0x5c
+    &disasm_jz_offset, &disasm_ajmp_offset, &disasm_xrl_mem_a, &disasm_xrl_mem_imm, // 0x60
+    &disasm_xrl_a_imm, &disasm_xrl_a_mem, &disasm_xrl_a_indir_rx, &disasm_xrl_a_indir_rx, // 0x64
+    &disasm_xrl_a_rx, &disasm_xrl_a_rx, &disasm_xrl_a_rx, &disasm_xrl_a_rx, // 0x68
+    &disasm_xrl_a_rx, &disasm_xrl_a_rx, &disasm_xrl_a_rx, &disasm_xrl_a_rx, // 0x6c
+    &disasm_jnz_offset, &disasm_acall_offset, &disasm_orl_c_bitaddr, &disasm_jmp_indir_a_dptr, // 0x70
+    &disasm_mov_a_imm, &disasm_mov_mem_imm, &disasm_mov_indir_rx_imm, &disasm_mov_indir_rx_imm, // 0x74
+    &disasm_mov_rx_imm, &disasm_mov_rx_imm, &disasm_mov_rx_imm, &disasm_mov_rx_imm, // 0x78
+    &disasm_mov_rx_imm, &disasm_mov_rx_imm, &disasm_mov_rx_imm, &disasm_mov_rx_imm, // 0x7c
+    &disasm_sjmp_offset, &disasm_ajmp_offset, &disasm_anl_c_bitaddr, &disasm_movc_a_indir_a_pc, // 0x80
+    &disasm_div_ab, &disasm_mov_mem_mem, &disasm_mov_mem_indir_rx, &disasm_mov_mem_indir_rx, // 0x84
+    &disasm_mov_mem_rx, &disasm_mov_mem_rx, &disasm_mov_mem_rx, &disasm_mov_mem_rx, // 0x88
+    &disasm_mov_mem_rx, &disasm_mov_mem_rx, &disasm_mov_mem_rx, &disasm_mov_mem_rx, // 0x8c
+    &disasm_mov_dptr_imm, &disasm_acall_offset, &disasm_mov_bitaddr_c, &disasm_movc_a_indir_a_dptr, // 0x90
+    &disasm_subb_a_imm, &disasm_subb_a_mem, &disasm_subb_a_indir_rx, &disasm_subb_a_indir_rx, // 0x94
+    &disasm_subb_a_rx, &disasm_subb_a_rx, &disasm_subb_a_rx, &disasm_subb_a_rx, // 0x98
+    &disasm_subb_a_rx, &disasm_subb_a_rx, &disasm_subb_a_rx, &disasm_subb_a_rx, // 0x9c
+    &disasm_orl_c_compl_bitaddr, &disasm_ajmp_offset, &disasm_mov_c_bitaddr, &disasm_inc_dptr, // 0xa0
+    &disasm_mul_ab, &disasm_nop, &disasm_mov_indir_rx_mem, &disasm_mov_indir_rx_mem, // 0xa4
+    &disasm_mov_rx_mem, &disasm_mov_rx_mem, &disasm_mov_rx_mem, &disasm_mov_rx_mem, // 0xa8
+    &disasm_mov_rx_mem, &disasm_mov_rx_mem, &disasm_mov_rx_mem, &disasm_mov_rx_mem, // 0xac
+    &disasm_anl_c_compl_bitaddr, &disasm_acall_offset, &disasm_cpl_bitaddr, &disasm_cpl_c, // 0xb0
+    &disasm_cjne_a_imm_offset, &disasm_cjne_a_mem_offset, &disasm_cjne_indir_rx_imm_offset, &disasm_cjne_indir_rx_imm_offset, // 0xb4
+    &disasm_cjne_rx_imm_offset, &disasm_cjne_rx_imm_offset, &disasm_cjne_rx_imm_offset, &disasm_cjne_rx_imm_offset, // 0xb8
+    &disasm_cjne_rx_imm_offset, &disasm_cjne_rx_imm_offset, &disasm_cjne_rx_imm_offset, &disasm_cjne_rx_imm_offset, // 0xbc
+    &disasm_push_mem, &disasm_ajmp_offset, &disasm_clr_bitaddr, &disasm_clr_c, // 0xc0
+    &disasm_swap_a, &disasm_xch_a_mem, &disasm_xch_a_indir_rx, &disasm_xch_a_indir_rx, // 0xc4
+    &disasm_xch_a_rx, &disasm_xch_a_rx, &disasm_xch_a_rx, &disasm_xch_a_rx, // 0xc8
+    &disasm_xch_a_rx, &disasm_xch_a_rx, &disasm_xch_a_rx, &disasm_xch_a_rx, // 0xcc
+    &disasm_pop_mem, &disasm_acall_offset, &disasm_setb_bitaddr, &disasm_setb_c, // 0xd0
+    &disasm_da_a, &disasm_djnz_mem_offset, &disasm_xchd_a_indir_rx, &disasm_xchd_a_indir_rx, // 0xd4
+    &disasm_djnz_rx_offset, &disasm_djnz_rx_offset, &disasm_djnz_rx_offset, &disasm_djnz_rx_offset, // 0xd8
+    &disasm_djnz_rx_offset, &disasm_djnz_rx_offset, &disasm_djnz_rx_offset, &disasm_djnz_rx_offset, // 0xdc
+    &disasm_movx_a_indir_dptr, &disasm_ajmp_offset, &disasm_movx_a_indir_rx, &disasm_movx_a_indir_rx, // 0xe0
+    &disasm_clr_a, &disasm_mov_a_mem, &disasm_mov_a_indir_rx, &disasm_mov_a_indir_rx, // 0xe4
+    &disasm_mov_a_rx, &disasm_mov_a_rx, &disasm_mov_a_rx, &disasm_mov_a_rx, // 0xe8
+    &disasm_mov_a_rx, &disasm_mov_a_rx, &disasm_mov_a_rx, &disasm_mov_a_rx, // 0xec
+    &disasm_movx_indir_dptr_a, &disasm_acall_offset, &disasm_movx_indir_rx_a, &disasm_movx_indir_rx_a, // 0xf0
+    &disasm_cpl_a, &disasm_mov_mem_a, &disasm_mov_indir_rx_a, &disasm_mov_indir_rx_a, // 0xf4
+    &disasm_mov_rx_a, &disasm_mov_rx_a, &disasm_mov_rx_a, &disasm_mov_rx_a, // 0xf8
+    &disasm_mov_rx_a, &disasm_mov_rx_a, &disasm_mov_rx_a, &disasm_mov_rx_a // 0xfc
+};
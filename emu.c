@@ -45,11 +45,6 @@
 #include "emu8051.h"
 #include "emulator.h"
 
-unsigned char history[HISTORY_LINES * (128 + 64 + sizeof(int))];
-
-
-// current line in the history cyclic buffers
-int historyline = 0;
 // last known columns and rows; for screen resize detection
 int oldcols, oldrows;
 // are we in single-step or run mode
@@ -69,7 +64,11 @@ int view = MAIN_VIEW;
 // old port out values
 int pout[4] = { 0 };
 
-int breakpoint = -1;
+// ticks reported through the trace callback during the current batch
+unsigned int traced_ticks = 0;
+
+// checkpoints for stepping back
+struct em8051checkpoints checkpoints;
 
 // returns time in 1ms units
 int getTick()
@@ -232,6 +231,19 @@ uint8_t emu_sfrread(struct em8051 *aCPU, uint8_t aRegister)
 
 }
 
+void emu_trace(struct em8051 *aCPU, uint16_t aPC, uint8_t aTicks)
+{
+    int i;
+
+    icount++;
+
+    history_record(aCPU, aPC);
+
+    for (i = 0; i < aTicks; i++)
+        logicboard_tick(aCPU);
+    traced_ticks += aTicks;
+}
+
 void refreshview(struct em8051 *aCPU)
 {
     change_view(aCPU, view);
@@ -277,7 +289,7 @@ int main(int parc, char ** pars)
     int ch = 0;
     struct em8051 emu;
     int i;
-    int ticked = 1;
+    int history_kb = HISTORY_BYTES / 1024;
 
     memset(&emu, 0, sizeof(emu));
     emu.mCodeMemMaxIdx = 65536-1;
@@ -288,6 +300,8 @@ int main(int parc, char ** pars)
     emu.except       = &emu_exception;
     emu.xread = NULL;
     emu.xwrite = NULL;
+    emu.trace = emu_trace;
+    emu.mBreakpoint = -1;
 
     emu.sfrwrite[REG_SBUF] = emu_sfrwrite_SBUF;
 
@@ -297,6 +311,7 @@ int main(int parc, char ** pars)
     emu.sfrread[REG_P3] = emu_sfrread;
 
     reset(&emu, 1);
+    decode_cache(&emu, 1);
 
     if (parc > 1)
     {
@@ -392,6 +407,13 @@ int main(int parc, char ** pars)
                         opt_clock_hz = 1;
                 }
                 else
+                if (strncmp("history=",pars[i]+1,8) == 0)
+                {
+                    history_kb = atoi(pars[i]+9);
+                    if (history_kb <= 0)
+                        history_kb = 1;
+                }
+                else
                 {
                     printf("Help:\n\n"
                         "emu8051 [options] [filename]\n\n"
@@ -407,6 +429,7 @@ int main(int parc, char ** pars)
                         "-iolowlow         If out pin is low, hi input from same pin is low\n"
                         "-iolowrand        If out pin is low, hi input from same pin is random\n"
                         "-clock=value      Set clock speed, in Hz\n"
+                        "-history=value    Set instruction history buffer size, in KB\n"
                         );
                     return -1;
                 }
@@ -426,6 +449,18 @@ int main(int parc, char ** pars)
         }
     }
 
+    if (history_init(history_kb * 1024) != 0)
+    {
+        printf("Out of memory for history\n");
+        return -1;
+    }
+
+    if (!checkpoints_init(&checkpoints, &emu, CHECKPOINT_COUNT, CHECKPOINT_INTERVAL))
+    {
+        printf("Out of memory for checkpoints\n");
+        return -1;
+    }
+
     //  Initialize ncurses
 
     slk_init(1);
@@ -479,18 +514,19 @@ int main(int parc, char ** pars)
             change_view(&emu, (view + 1) % 4);
             break;
         case 'k':
-            if (breakpoint != -1)
+            if (emu.mBreakpoint != -1)
             {
-                breakpoint = -1;
+                emu.mBreakpoint = -1;
                 emu_popup(&emu, "Breakpoint", "Breakpoint cleared.");
             }
             else
             {
-                breakpoint = emu_readvalue(&emu, "Set Breakpoint", emu.mPC, 4);
+                emu.mBreakpoint = emu_readvalue(&emu, "Set Breakpoint", emu.mPC, 4);
             }
             break;
         case 'g':
             emu.mPC = emu_readvalue(&emu, "Set Program Counter", emu.mPC, 4);
+            checkpoints_clear(&checkpoints, &emu);
             break;
         case 'h':
             emu_help(&emu);
@@ -536,20 +572,21 @@ int main(int parc, char ** pars)
             if (emu_reset(&emu))
             {
                 clocks = 0;
-                ticked = 1;
+                checkpoints_clear(&checkpoints, &emu);
             }
             break;
         case 'z':
 	    // Equivalent of "R)eset (init regs, set PC to zero)"
 	    reset(&emu, 0);
+	    checkpoints_clear(&checkpoints, &emu);
 	    break;
         case 'Z':
 	    // Equivalent of "W)ipe (init regs, set PC to zero, clear memory)"
 	    reset(&emu, 1);
+	    checkpoints_clear(&checkpoints, &emu);
 	    break;
         case KEY_END:
             clocks = 0;
-            ticked = 1;
             break;
         default:
             // by default, send keys to the current view
@@ -591,40 +628,40 @@ int main(int parc, char ** pars)
 
             do
             {
-                int old_pc;
-                old_pc = emu.mPC;
+                unsigned int consumed;
+                int stop;
+                traced_ticks = 0;
                 if (opt_step_instruction)
                 {
-                    ticked = 0;
-                    while (!ticked)
+                    // run until an operation has been executed
+                    consumed = 0;
+                    do
                     {
-                        targetclocks--;
-                        clocks += 12;
-                        ticked = tick(&emu);
-                        logicboard_tick(&emu);
+                        consumed += checkpoints_run(&checkpoints, &emu, 1, &stop);
                     }
+                    while (!traced_ticks && stop == STOP_BUDGET);
                 }
                 else
                 {
-                    targetclocks--;
-                    clocks += 12;
-                    ticked = tick(&emu);
-                    logicboard_tick(&emu);
+                    consumed = checkpoints_run(&checkpoints, &emu, targetclocks, &stop);
                 }
 
-                if (emu.mPC == breakpoint)
-                    emu_exception(&emu, -1);
-
-                if (ticked)
+                // ticks spent on interrupt calls don't go through the trace callback
+                while (traced_ticks < consumed)
                 {
-                    icount++;
+                    logicboard_tick(&emu);
+                    traced_ticks++;
+                }
 
-                    historyline = (historyline + 1) % HISTORY_LINES;
+                clocks += 12 * consumed;
+                targetclocks = consumed < targetclocks ? targetclocks - consumed : 0;
 
-                    memcpy(history + (historyline * (128 + 64 + sizeof(int))), emu.mSFR, 128);
-                    memcpy(history + (historyline * (128 + 64 + sizeof(int))) + 128, emu.mLowerData, 64);
-                    memcpy(history + (historyline * (128 + 64 + sizeof(int))) + 128 + 64, &old_pc, sizeof(int));
-                }
+                if (stop == STOP_BREAKPOINT)
+                    emu_exception(&emu, -1);
+
+                // the exception popup stops the run unless the exception is disabled
+                if (stop != STOP_BUDGET && !runmode)
+                    break;
             }
             while (targettime > getTick() && targetclocks > 0);
 
@@ -656,58 +693,3 @@ int main(int parc, char ** pars)
 
     return EXIT_SUCCESS;
 }
-
-int readbyte(FILE * f)
-{
-    char data[3];
-    data[0] = fgetc(f);
-    data[1] = fgetc(f);
-    data[2] = 0;
-    return strtol(data, NULL, 16);
-}
-
-int load_obj(struct em8051 *aCPU, char *aFilename)
-{
-    FILE *f;
-    if (aFilename == 0 || aFilename[0] == 0)
-        return -1;
-    f = fopen(aFilename, "r");
-    if (!f) return -1;
-    if (fgetc(f) != ':')
-    {
-	  fclose(f);
-        return -2; // unsupported file format
-    }
-    while (!feof(f))
-    {
-        int recordlength;
-        int address;
-        int recordtype;
-        int checksum;
-        int i;
-        recordlength = readbyte(f);
-        address = readbyte(f);
-        address <<= 8;
-        address |= readbyte(f);
-        recordtype = readbyte(f);
-        if (recordtype == 1)
-            return 0; // we're done
-        if (recordtype != 0)
-            return -3; // unsupported record type
-        checksum = recordtype + recordlength + (address & 0xff) + (address >> 8); // final checksum = 1 + not(checksum)
-        for (i = 0; i < recordlength; i++)
-        {
-            int data = readbyte(f);
-            checksum += data;
-            aCPU->mCodeMem[address + i] = data;
-        }
-        i = readbyte(f);
-        checksum &= 0xff;
-        checksum = 256 - checksum;
-        if (i != (checksum & 0xff))
-            return -4; // checksum failure
-        while (fgetc(f) != ':' && !feof(f)) {} // skip newline
-    }
-	  fclose(f);
-    return -5;
-}
@@ -30,6 +30,7 @@
 #include <stdbool.h>
 
 struct em8051;
+struct em8051jit;
 
 // Operation: returns number of ticks the operation should take
 typedef uint8_t (*em8051operation)(struct em8051 *aCPU);
@@ -59,28 +60,127 @@ typedef void (*em8051xwrite)(struct em8051 *aCPU, uint16_t aAddress, uint8_t aVa
 // (can be used to control some peripherals)
 typedef uint8_t (*em8051xread)(struct em8051 *aCPU, uint16_t aAddress);
 
+// Callback: an operation was executed by run_cycles()
+// aPC is the address of the operation, aTicks the number of ticks it takes.
+// Default is to do nothing (can be used for history, tracing etc)
+typedef void (*em8051trace)(struct em8051 *aCPU, uint16_t aPC, uint8_t aTicks);
+
+// Longest run of operations grouped into one block
+#define BLOCK_MAX_OPS 16
+// Block information not built yet
+#define BLOCK_UNKNOWN 0xff
+
+// Operations that jump back to themselves, see loop_count()
+enum EM8051_LOOP
+{
+    LOOP_NONE,
+    LOOP_SPIN, // sjmp $, ajmp $, ljmp $
+    LOOP_WAIT, // jb bit,$ and jnb bit,$ on a bit only interrupts or timers change
+    LOOP_DELAY // djnz Rn,$ and djnz iram,$
+};
+
+// Loop that only a timer event or an interrupt can end
+#define LOOP_FOREVER 0xffffffff
+
+// Pre-decoded operation, see decode_cache()
+struct em8051decoded
+{
+    em8051operation op; // opcode handler; NULL if not decoded yet
+    uint8_t opcode;
+    uint8_t operand[2]; // bytes following the opcode
+    uint8_t length; // length of the operation in bytes
+    uint8_t ticks; // ticks the operation takes
+    // Block starting at this address: operations that can run back to back
+    // without checking interrupts or ticking the timers in between
+    uint8_t block_ops; // number of operations, or BLOCK_UNKNOWN
+    uint8_t block_ticks; // total ticks of the operations
+    uint8_t block_bytes; // total length of the operations
+    uint8_t loop; // EM8051_LOOP of the operation, set with the block
+};
+
+// Opcode handlers compiled for one memory configuration, see reset()
+struct em8051core
+{
+    const em8051operation *op; // handlers by opcode
+    uint8_t (*do_op)(struct em8051 *aCPU); // as do_op()
+    // as run_threaded(); NULL unless built with DISPATCH=threaded, but always
+    // here so the struct is the same in every build
+    uint32_t (*run_threaded)(struct em8051 *aCPU, uint32_t aBudget);
+};
+
+// Sources of timer events, see timer_sync()
+enum EM8051_EVENT
+{
+    EVENT_TIMER0, // timer 0 overflow
+    EVENT_TIMER1, // timer 1 (or TH0 in mode 3) overflow, serial bit
+    EVENT_COUNT
+};
 
 struct em8051
 {
+    // Architectural state, touched by every operation; kept together at
+    // the front
+    uint16_t mPC; // Program Counter; outside memory area
+    uint8_t mTickDelay; // How many ticks should we delay before continuing
+    // Internal values for interrupt services etc.
+    uint8_t mInterruptActive;
+    // Raised and enabled interrupts, one bit per source in IE bit order;
+    // the high byte holds the ones with high priority. See interrupt_update()
+    uint16_t mInterruptPending;
+    // Arithmetic flags not yet written to PSW, see update_flags()
+    uint8_t mFlagOp; // FLAGS_NONE, FLAGS_ADD or FLAGS_SUB
+    uint8_t mFlagValue[2]; // operands
+    bool mFlagCarry; // carry in
+    unsigned char mSFR[128]; // 128 bytes; (special function registers)
+    unsigned char mLowerData[128]; // 128 bytes
+
+    uint64_t mCycles; // ticks run since reset
+    uint64_t mOperations; // operations run since reset, not counting interrupt calls
+
+    // The timer registers are brought up to date only when they are
+    // accessed or a timer event is due
+    uint64_t mTimerSync; // tick the timer registers are current at
+    uint64_t mEvent[EVENT_COUNT]; // tick of the next event of each source
+    uint64_t mNextEvent; // earliest of mEvent
+
     unsigned char *mCodeMem; // 1k - 64k, must be power of 2
     uint16_t mCodeMemMaxIdx;
     unsigned char *mExtData; // 0 - 64k, must be power of 2
     uint16_t mExtDataMaxIdx;
-    unsigned char mLowerData[128]; // 128 bytes
     unsigned char *mUpperData; // 0 or 128 bytes; leave to NULL if none
-    unsigned char mSFR[128]; // 128 bytes; (special function registers)
-    uint16_t mPC; // Program Counter; outside memory area
-    uint8_t mTickDelay; // How many ticks should we delay before continuing
-    em8051operation op[256]; // function pointers to opcode handlers
-    em8051decoder dec[256]; // opcode-to-string decoder handlers    
+    struct em8051decoded *mDecoded; // pre-decoded code memory; NULL if not in use
+    struct em8051jit *mJit; // native code for hot blocks; NULL if not in use
+    // Opcode handlers for the memory configuration above; picked by reset()
+    const struct em8051core *mCore;
+    // 256-byte pages of external memory written by MOVX since the snapshot
+    // numbered mXBaseline was taken or restored (0 for none), see
+    // em8051_restore_dirty(). Snapshots of the instance are numbered from
+    // mXSerial on.
+    uint8_t mXDirty[256];
+    uint32_t mXBaseline;
+    uint32_t mXSerial;
+
+    // run_cycles() stops when PC reaches this; -1 for none. reset() leaves
+    // it alone, so set it up along with the memories and callbacks
+    int mBreakpoint;
+    int mException; // last exception code raised during run_cycles(), or -1
+
     em8051exception except; // callback: exceptional situation occurred
     em8051sfrread sfrread[128]; // callback array: SFR register being read
     em8051sfrwrite sfrwrite[128]; // callback array: SFR register written
     em8051xread xread; // callback: external memory being read
     em8051xwrite xwrite; // callback: external memory being written
+    // callback arrays by 256-byte page of external memory, see xdata_map()
+    em8051xread xreadpage[256];
+    em8051xwrite xwritepage[256];
+    em8051trace trace; // callback: operation executed by run_cycles()
+    // checkpoint ring logging what the read callbacks return, see
+    // checkpoints_init(); NULL if none
+    struct em8051checkpoints *mCheckpoints;
+
+    // Everything from here on is state too, copied by em8051_restore()
+    // along with the front of the struct
 
-    // Internal values for interrupt services etc.
-    uint8_t mInterruptActive;
     // Stored register values for interrupts (exception checking)
     uint8_t int_a[2];
     uint8_t int_psw[2];
@@ -93,15 +193,152 @@ struct em8051
     bool serial_interrupt_trigger;
 };
 
-// set the emulator into reset state. Must be called before tick(), as
-// it also initializes the function pointers. aWipe tells whether to reset
-// all memory to zero.
+// Saved state of an instance, see em8051_snapshot()
+struct em8051snapshot
+{
+    struct em8051 mState; // registers, timers, interrupt and serial state, callbacks
+    unsigned char *mExtData; // copy of external data memory; NULL if none
+    unsigned char mUpperData[128]; // copy of upper RAM
+    bool mCodeAliased; // code memory is the external data memory
+    const struct em8051 *mSource; // instance the snapshot was taken of
+    uint32_t mSerial; // number among the snapshots of mSource
+};
+
+// Checkpoints of an instance for running backwards, see checkpoints_init()
+struct em8051checkpoints
+{
+    struct em8051snapshot **mSnapshots; // ring of mSlots, oldest at mOldest
+    uint64_t *mInputAt; // input log position of each checkpoint
+    int mSlots;
+    int mCount;
+    int mOldest;
+    uint32_t mInterval; // ticks between checkpoints
+    uint64_t mNext; // tick the next checkpoint is due at
+    // Values returned by the read callbacks since the oldest checkpoint;
+    // positions count from the first value ever logged
+    uint8_t *mInput;
+    uint32_t mInputSize;
+    uint64_t mInputBase; // position of mInput[0]
+    uint64_t mInputEnd;
+    uint64_t mInputPos; // next value to hand out while replaying
+    bool mReplaying;
+    // Operation search while replaying, see checkpoints_reverse_continue()
+    int mFindPC; // -1 for any operation
+    uint64_t mFound; // tick the last matching operation started at
+    int mFoundOps; // operations started since then
+    int mOps; // operations started during the replay
+};
+
+// Opcode handlers and opcode-to-string decoders, by opcode; shared by all
+// instances
+extern const em8051operation op_table[256];
+extern const em8051decoder dec_table[256];
+
+// The generic core, and ones with the memory sizes built in: 64k code, 64k
+// external data and upper RAM (8052); 4k or 2k code, no upper RAM (8051, 2051)
+extern const struct em8051core core_ops, core_ops_8052, core_ops_8051, core_ops_2051;
+
+// set the emulator into reset state. Must be called before tick(), and
+// again if the memory configuration is changed.
+// aWipe tells whether to reset all memory to zero.
 void reset(struct em8051 *aCPU, bool aWipe);
 
 // run one emulator tick, or 12 hardware clock cycles.
 // returns "true" if a new operation was executed.
 bool tick(struct em8051 *aCPU);
 
+// run ticks until aBudget ticks have been used, PC hits the breakpoint or
+// an exception is raised. An operation left unfinished when the budget runs
+// out is completed on the next call. Stores the reason for stopping (see
+// EM8051_STOP enum, below) in aStopReason and returns number of ticks run.
+uint32_t run_cycles(struct em8051 *aCPU, uint32_t aBudget, int *aStopReason);
+
+// enable or disable the pre-decoded operation cache. The cache is built
+// lazily as code is executed.
+void decode_cache(struct em8051 *aCPU, bool aEnable);
+
+// tell the core that code memory has been changed by the host, so any
+// pre-decoded operations covering the area are thrown away. Writes done by
+// the emulated program through aliased external memory are handled internally.
+void invalidate_code(struct em8051 *aCPU, uint16_t aAddress, uint32_t aLength);
+
+// map a memory-mapped peripheral into external memory: MOVX to the 256-byte
+// pages covering aAddress..aAddress+aLength-1 calls aRead/aWrite instead of
+// xread/xwrite or the memory. NULL callbacks make the pages plain memory
+// again. Pages without a peripheral cost nothing extra, but while any page
+// has a read callback MOVX reads are left out of blocks, as with xread.
+void xdata_map(struct em8051 *aCPU, uint16_t aAddress, uint32_t aLength, em8051xread aRead, em8051xwrite aWrite);
+
+// switch the JIT compiler (see EM8051_JIT_MODE enum, below). Blocks run by
+// run_cycles() often enough are compiled into native code; this needs the
+// decode cache and a build with EM8051_JIT defined on x86-64. In JIT_VERIFY
+// mode each compiled block is also run by the interpreter, and a difference
+// raises EXCEPTION_JIT_MISMATCH. Returns false if the JIT is not available.
+bool jit_mode(struct em8051 *aCPU, int aMode);
+
+// save the whole state of the instance: registers, timers, interrupt and
+// serial state, internal and external memory, and code memory if external
+// memory is aliased over it. Free with em8051_snapshot_free(). Returns NULL
+// if out of memory.
+struct em8051snapshot *em8051_snapshot(struct em8051 *aCPU);
+
+// bring an instance with the same memory configuration back to the state
+// in the snapshot. Memories and callbacks of aCPU stay its own.
+void em8051_restore(struct em8051 *aCPU, const struct em8051snapshot *aSnapshot);
+
+// as em8051_restore(), but only copies back the pages of external memory
+// MOVX has written since the snapshot was taken or last restored. Changes
+// the host makes to external memory directly are not seen. Cost is in
+// proportion to what was touched, for running many tests from one state.
+// Only works that way while aSnapshot is the last snapshot the instance
+// took or was restored to; otherwise all of external memory is copied.
+void em8051_restore_dirty(struct em8051 *aCPU, const struct em8051snapshot *aSnapshot);
+
+// make aChild a new instance in the state of the snapshot, with the same
+// callbacks and memories of its own. Code memory is shared with the
+// instance the snapshot was taken from (unless external memory is aliased
+// over code), so it must keep it as long as the fork lives. A fork starts
+// with no decode cache or JIT, so forks can run on threads of their own;
+// call decode_cache() on it to have one. Release with em8051_fork_free().
+// Returns false if out of memory.
+bool em8051_fork(struct em8051 *aChild, const struct em8051snapshot *aSnapshot);
+
+// release the memories em8051_fork() set up for aChild, and its decode
+// cache if it has one
+void em8051_fork_free(struct em8051 *aChild);
+
+// release a snapshot
+void em8051_snapshot_free(struct em8051snapshot *aSnapshot);
+
+// keep a checkpoint of the instance every aInterval ticks, aCount at most,
+// so it can be run backwards: an earlier state is reached by restoring the
+// checkpoint before it and replaying from there at full speed. The first
+// checkpoint is taken right away. Run with checkpoints_run() from then on.
+// Values the SFR and external memory read callbacks return are logged, so
+// replays see the same inputs without calling them again; the other
+// callbacks are called again. Returns false if out of memory.
+bool checkpoints_init(struct em8051checkpoints *aRing, struct em8051 *aCPU, int aCount, uint32_t aInterval);
+
+// forget the past and take a new first checkpoint; call after reset(),
+// loading code or changing the state from outside
+void checkpoints_clear(struct em8051checkpoints *aRing, struct em8051 *aCPU);
+
+// release the checkpoints and the input log
+void checkpoints_free(struct em8051checkpoints *aRing, struct em8051 *aCPU);
+
+// as run_cycles(), taking checkpoints as they come due
+uint32_t checkpoints_run(struct em8051checkpoints *aRing, struct em8051 *aCPU, uint32_t aBudget, int *aStopReason);
+
+// go back to where the last operation started. Returns the number of
+// operations gone back (as seen by the trace callback), or 0 if it is
+// older than the oldest checkpoint. Later checkpoints are dropped.
+int checkpoints_step_back(struct em8051checkpoints *aRing, struct em8051 *aCPU);
+
+// go back to the last time an operation at mBreakpoint was about to run.
+// Returns the number of operations gone back, or 0 (and stays put) if the
+// breakpoint wasn't hit since the oldest checkpoint.
+int checkpoints_reverse_continue(struct em8051checkpoints *aRing, struct em8051 *aCPU);
+
 // decode the next operation as character string.
 // buffer must be big enough (64 bytes is very safe). 
 // Returns length of opcode.
@@ -113,6 +350,63 @@ int load_obj(struct em8051 *aCPU, char *aFilename);
 // Alternate way to execute an opcode (switch-structure instead of function pointers)
 uint8_t do_op(struct em8051 *aCPU);
 
+// Alternate way to run operations: each handler jumps directly to the next
+// one (computed goto; build with DISPATCH=threaded). Used by run_cycles()
+// when the decode cache is off; returns number of ticks run.
+uint32_t run_threaded(struct em8051 *aCPU, uint32_t aBudget);
+
+// Internal: Fills in the pre-decoded operation at code memory address
+struct em8051decoded *decode_operation(struct em8051 *aCPU, uint16_t aAddress);
+
+// Internal: Finds the block starting at code memory address
+void decode_block(struct em8051 *aCPU, uint16_t aAddress);
+
+// Internal: Number of times a loop operation at PC jumps back to itself
+// before it falls through, if nothing else runs in between
+uint32_t loop_count(struct em8051 *aCPU, struct em8051decoded *aOp);
+
+// Internal: Runs iterations of a loop operation at PC that jump back to itself
+void loop_advance(struct em8051 *aCPU, struct em8051decoded *aOp, uint32_t aCount);
+
+// Internal: Runs the operations of a block through the interpreter,
+// returns the ticks value of the last one
+uint8_t run_block_ops(struct em8051 *aCPU, struct em8051decoded *aBlock);
+
+// Internal: Runs the block at PC as native code, if it has been compiled
+bool jit_run(struct em8051 *aCPU, struct em8051decoded *aBlock, uint8_t *aTicks);
+
+// Internal: Throws away native code covering the code memory area
+void jit_invalidate(struct em8051 *aCPU, uint16_t aAddress, uint32_t aLength);
+
+// Internal: Runs timers and serial port for one tick
+void timer_tick(struct em8051 *aCPU);
+
+// Internal: Brings the timer registers up to date with mCycles
+void timer_sync(struct em8051 *aCPU);
+
+// Internal: The timer registers (or SCON) are about to be changed
+void timer_changed(struct em8051 *aCPU);
+
+// Internal: Works out mInterruptPending again after IE, IP, TCON or the
+// serial trigger change
+void interrupt_update(struct em8051 *aCPU);
+
+// Internal: Writes C, AC and OV of the last add/subtract into PSW
+void update_flags(struct em8051 *aCPU);
+
+// Internal: Updates the parity bit from the accumulator
+void update_parity(struct em8051 *aCPU);
+
+// Internal: Value of an SFR read callback, through the checkpoint log
+uint8_t checkpoints_sfrread(struct em8051 *aCPU, uint8_t aRegister);
+
+// Internal: Value of an external memory read callback, through the
+// checkpoint log
+uint8_t checkpoints_xread(struct em8051 *aCPU, em8051xread aRead, uint16_t aAddress);
+
+// Internal: Starts an interrupt call if one is due
+void handle_interrupts(struct em8051 *aCPU);
+
 // Internal: Pushes a value into stack
 void push_to_stack(struct em8051 *aCPU, uint8_t aValue);
 
@@ -257,6 +551,28 @@ enum EM8051_EXCEPTION
     EXCEPTION_IRET_PSW_MISMATCH, // psw not preserved over interrupt call (doesn't care about P, F0 or UNUSED)
     EXCEPTION_IRET_SP_MISMATCH,  // sp not preserved over interrupt call
     EXCEPTION_IRET_ACC_MISMATCH, // acc not preserved over interrupt call
-    EXCEPTION_ILLEGAL_OPCODE     // for the single 'reserved' opcode in the architecture
+    EXCEPTION_ILLEGAL_OPCODE,    // for the single 'reserved' opcode in the architecture
+    EXCEPTION_JIT_MISMATCH       // native code and interpreter disagree (JIT_VERIFY mode)
+};
+
+enum EM8051_STOP
+{
+    STOP_BUDGET,     // all of the requested ticks were run
+    STOP_BREAKPOINT, // PC reached mBreakpoint
+    STOP_EXCEPTION   // except callback was called
+};
+
+
+enum EM8051_FLAGS
+{
+    FLAGS_NONE, // PSW is up to date
+    FLAGS_ADD,  // ADD/ADDC pending
+    FLAGS_SUB   // SUBB pending
 };
 
+enum EM8051_JIT_MODE
+{
+    JIT_OFF,    // interpreter only
+    JIT_ON,     // compile hot blocks into native code
+    JIT_VERIFY  // as JIT_ON, but check every native run against the interpreter
+};
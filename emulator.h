@@ -26,9 +26,16 @@
  * Curses-based emulator front-end
  */
 
-// how many lines of history to remember
+// how many lines of history to show
 #define HISTORY_LINES 20
 
+// default history buffer size, in bytes
+#define HISTORY_BYTES (16 * 1024 * 1024)
+
+// checkpoints kept for stepping back, and ticks between them
+#define CHECKPOINT_COUNT 100
+#define CHECKPOINT_INTERVAL 100000
+
 enum EMU_VIEWS
 {
     MAIN_VIEW = 0,
@@ -38,17 +45,15 @@ enum EMU_VIEWS
 };
 
 
-// binary history buffer
-extern unsigned char history[];
-
 // last used filename
 extern char filename[];
 
+// checkpoints for stepping back
+extern struct em8051checkpoints checkpoints;
+
 // instruction count; needed to replay history correctly
 extern unsigned int icount;
 
-// current line in the history cyclic buffers
-extern int historyline;
 // last known columns and rows; for screen resize detection
 extern int oldcols, oldrows;
 // are we in single-step or run mode
@@ -113,6 +118,14 @@ extern void build_memeditor_view(struct em8051 *aCPU);
 extern void memeditor_editor_keys(struct em8051 *aCPU, int ch);
 extern void memeditor_update(struct em8051 *aCPU);
 
+// history.c
+extern int history_init(unsigned int aBytes);
+extern void history_clear();
+extern unsigned int history_depth();
+extern void history_record(struct em8051 *aCPU, uint16_t aPC);
+extern void history_rewind(unsigned int aCount);
+extern int history_get(unsigned int aBack, int *aPC, unsigned char *aState);
+
 // options.c
 extern void wipe_options_view();
 extern void build_options_view(struct em8051 *aCPU);
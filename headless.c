@@ -0,0 +1,361 @@
+/* 8051 emulator core
+ * Copyright 2006 Jari Komppa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining 
+ * a copy of this software and associated documentation files (the 
+ * "Software"), to deal in the Software without restriction, including 
+ * without limitation the rights to use, copy, modify, merge, publish, 
+ * distribute, sublicense, and/or sell copies of the Software, and to 
+ * permit persons to whom the Software is furnished to do so, subject 
+ * to the following conditions: 
+ *
+ * The above copyright notice and this permission notice shall be included 
+ * in all copies or substantial portions of the Software. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+ * IN THE SOFTWARE. 
+ *
+ * (i.e. the MIT License)
+ *
+ * headless.c
+ * Runs one program at full speed without the curses front-end, for batch
+ * and CI use
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "emu8051.h"
+
+// Exit codes
+enum HEADLESS_EXIT
+{
+    EXIT_STOP = 0, // reached the stop PC, or the cycle limit if there is no stop PC
+    EXIT_LIMIT = 1, // reached the cycle limit before the stop PC
+    EXIT_EXCEPTION = 2, // an exception stopped the run
+    EXIT_ERROR = 3 // bad options, out of memory, or the files couldn't be loaded
+};
+
+// A port input from the script: from tick mTick on, reading port mPort
+// gives mValue
+struct portinput
+{
+    uint64_t mTick;
+    int mPort;
+    uint8_t mValue;
+    int mLine; // keeps the order of the file for the same tick
+};
+
+static struct portinput *inputs = NULL;
+static int input_count = 0;
+// next input not applied yet
+static int input_next = 0;
+// current input value of each port
+static uint8_t port_value[4] = { 0xff, 0xff, 0xff, 0xff };
+// echo bytes written to SBUF to stdout
+static int opt_serial = 0;
+
+static const uint8_t port_reg[4] = { REG_P0, REG_P1, REG_P2, REG_P3 };
+
+static void headless_exception(struct em8051 *aCPU, int aCode)
+{
+    // run_cycles() stops and reports the code
+}
+
+static void headless_sfrwrite_SBUF(struct em8051 *aCPU, uint8_t aRegister)
+{
+    aCPU->serial_out_remaining_bits = 8;
+    if (opt_serial)
+        putchar(aCPU->mSFR[REG_SBUF]);
+}
+
+static uint8_t headless_sfrread(struct em8051 *aCPU, uint8_t aRegister)
+{
+    int port;
+
+    while (input_next < input_count && inputs[input_next].mTick <= aCPU->mCycles)
+    {
+        port_value[inputs[input_next].mPort] = inputs[input_next].mValue;
+        input_next++;
+    }
+    for (port = 0; port < 4; port++)
+        if (aRegister == port_reg[port] + 0x80)
+            return port_value[port];
+    return aCPU->mSFR[aRegister - 0x80];
+}
+
+static int compare_inputs(const void *aA, const void *aB)
+{
+    const struct portinput *a = aA, *b = aB;
+    if (a->mTick != b->mTick)
+        return a->mTick < b->mTick ? -1 : 1;
+    return a->mLine - b->mLine;
+}
+
+// Port script: one input per line, "cycle port value", e.g. "1000 P1 fe",
+// value in hex; # starts a comment
+static int read_inputs(const char *aFilename)
+{
+    char line[256];
+    int size = 0;
+    int lineno = 0;
+    FILE *f = fopen(aFilename, "r");
+
+    if (!f)
+    {
+        printf("File '%s' not found\n", aFilename);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f))
+    {
+        unsigned long long tick;
+        unsigned int value;
+        char port[8];
+
+        lineno++;
+        if (line[strspn(line, " \t\r\n")] == 0 || line[strspn(line, " \t")] == '#')
+            continue;
+        if (sscanf(line, "%llu %7s %x", &tick, port, &value) != 3 ||
+            (port[0] != 'P' && port[0] != 'p') || port[1] < '0' || port[1] > '3' || port[2] != 0 ||
+            value > 0xff)
+        {
+            printf("%s line %d: expected \"cycle P0-P3 hexvalue\"\n", aFilename, lineno);
+            fclose(f);
+            return -1;
+        }
+        if (input_count == size)
+        {
+            struct portinput *grown;
+            size = size ? size * 2 : 64;
+            grown = realloc(inputs, size * sizeof(struct portinput));
+            if (!grown)
+            {
+                printf("Out of memory\n");
+                fclose(f);
+                return -1;
+            }
+            inputs = grown;
+        }
+        inputs[input_count].mTick = tick;
+        inputs[input_count].mPort = port[1] - '0';
+        inputs[input_count].mValue = value;
+        inputs[input_count].mLine = lineno;
+        input_count++;
+    }
+    fclose(f);
+    qsort(inputs, input_count, sizeof(struct portinput), compare_inputs);
+    return 0;
+}
+
+// Memory sizes must be powers of two
+static int is_pow2(long aValue)
+{
+    return aValue > 0 && (aValue & (aValue - 1)) == 0;
+}
+
+static const char *stop_name(int aStop)
+{
+    switch (aStop)
+    {
+    case STOP_BREAKPOINT: return "stop PC";
+    case STOP_EXCEPTION: return "exception";
+    }
+    return "cycle limit";
+}
+
+static void print_state(struct em8051 *aCPU)
+{
+    int rx = 8 * ((aCPU->mSFR[REG_PSW] & (PSWMASK_RS0|PSWMASK_RS1))>>PSW_RS0);
+    int i;
+
+    printf("PC=%04X A=%02X B=%02X PSW=%02X SP=%02X DPTR=%04X\n",
+        aCPU->mPC, aCPU->mSFR[REG_ACC], aCPU->mSFR[REG_B], aCPU->mSFR[REG_PSW],
+        aCPU->mSFR[REG_SP], (aCPU->mSFR[REG_DPH]<<8)|aCPU->mSFR[REG_DPL]);
+    printf("R0-R7=");
+    for (i = 0; i < 8; i++)
+        printf("%02X%s", aCPU->mLowerData[rx + i], i < 7 ? " " : "\n");
+    printf("P0=%02X P1=%02X P2=%02X P3=%02X IE=%02X IP=%02X\n",
+        aCPU->mSFR[REG_P0], aCPU->mSFR[REG_P1], aCPU->mSFR[REG_P2], aCPU->mSFR[REG_P3],
+        aCPU->mSFR[REG_IE], aCPU->mSFR[REG_IP]);
+    printf("TMOD=%02X TCON=%02X TH0=%02X TL0=%02X TH1=%02X TL1=%02X SCON=%02X PCON=%02X\n",
+        aCPU->mSFR[REG_TMOD], aCPU->mSFR[REG_TCON], aCPU->mSFR[REG_TH0], aCPU->mSFR[REG_TL0],
+        aCPU->mSFR[REG_TH1], aCPU->mSFR[REG_TL1], aCPU->mSFR[REG_SCON], aCPU->mSFR[REG_PCON]);
+    for (i = 0; i < (aCPU->mUpperData ? 256 : 128); i++)
+    {
+        if ((i & 15) == 0)
+            printf("%02X:", i);
+        printf(" %02X", i < 128 ? aCPU->mLowerData[i] : aCPU->mUpperData[i - 128]);
+        if ((i & 15) == 15)
+            printf("\n");
+    }
+}
+
+int main(int parc, char ** pars)
+{
+    struct em8051 emu;
+    struct timespec start, end;
+    const char *filename = NULL;
+    const char *portfile = NULL;
+    uint64_t limit = 0;
+    long code_size = 65536;
+    long xdata_size = 65536;
+    int iram_size = 256;
+    int clock_hz = 12*1000*1000;
+    int stop_pc = -1;
+    int exceptions = 1;
+    int stop = STOP_BUDGET;
+    double seconds;
+    int i;
+
+    for (i = 1; i < parc; i++)
+    {
+        if (pars[i][0] == '-')
+        {
+            if (strncmp("cycles=", pars[i]+1, 7) == 0)
+            {
+                limit = strtoull(pars[i]+8, NULL, 10);
+            }
+            else
+            if (strncmp("stop=", pars[i]+1, 5) == 0)
+            {
+                stop_pc = (int)strtol(pars[i]+6, NULL, 16) & 0xffff;
+            }
+            else
+            if (strncmp("clock=", pars[i]+1, 6) == 0)
+            {
+                clock_hz = atoi(pars[i]+7);
+                if (clock_hz <= 0)
+                    clock_hz = 1;
+            }
+            else
+            if (strncmp("code=", pars[i]+1, 5) == 0)
+            {
+                code_size = atol(pars[i]+6);
+            }
+            else
+            if (strncmp("xdata=", pars[i]+1, 6) == 0)
+            {
+                xdata_size = atol(pars[i]+7);
+            }
+            else
+            if (strncmp("iram=", pars[i]+1, 5) == 0)
+            {
+                iram_size = atoi(pars[i]+6);
+            }
+            else
+            if (strncmp("ports=", pars[i]+1, 6) == 0)
+            {
+                portfile = pars[i]+7;
+            }
+            else
+            if (strcmp("serial", pars[i]+1) == 0)
+            {
+                opt_serial = 1;
+            }
+            else
+            if (strcmp("noexc", pars[i]+1) == 0)
+            {
+                exceptions = 0;
+            }
+            else
+            {
+                filename = NULL;
+                break;
+            }
+        }
+        else
+        {
+            filename = pars[i];
+        }
+    }
+
+    if (!filename ||
+        !is_pow2(code_size) || code_size < 1024 || code_size > 65536 ||
+        (xdata_size != 0 && (!is_pow2(xdata_size) || xdata_size > 65536)) ||
+        (iram_size != 128 && iram_size != 256))
+    {
+        printf("Usage: emu-headless [options] filename\n\n"
+            "Runs the Intel HEX file at full speed without the UI, and prints the\n"
+            "final state and throughput. Available options:\n\n"
+            "-cycles=value     Stop after this many machine cycles (default: no limit)\n"
+            "-stop=address     Stop when PC reaches this address (hex)\n"
+            "-clock=value      Clock speed for the emulated time, in Hz\n"
+            "-code=bytes       Code memory size, 1024-65536, power of two\n"
+            "-xdata=bytes      External data memory size, 0-65536, power of two\n"
+            "-iram=bytes       Internal RAM size, 128 or 256\n"
+            "-ports=filename   Port input script, lines of \"cycle P0-P3 hexvalue\"\n"
+            "-serial           Echo bytes written to SBUF to stdout\n"
+            "-noexc            Disable all debug exceptions\n\n"
+            "Exit code: 0 stop PC reached (or the cycle limit, if no stop PC),\n"
+            "1 cycle limit reached first, 2 exception, 3 error.\n");
+        return EXIT_ERROR;
+    }
+
+    memset(&emu, 0, sizeof(emu));
+    emu.mCodeMemMaxIdx = code_size - 1;
+    emu.mCodeMem = calloc(code_size, sizeof(unsigned char));
+    emu.mExtDataMaxIdx = xdata_size ? xdata_size - 1 : 0;
+    emu.mExtData = xdata_size ? calloc(xdata_size, sizeof(unsigned char)) : NULL;
+    emu.mUpperData = iram_size == 256 ? calloc(128, sizeof(unsigned char)) : NULL;
+    if (!emu.mCodeMem || (xdata_size && !emu.mExtData) || (iram_size == 256 && !emu.mUpperData))
+    {
+        printf("Out of memory\n");
+        return EXIT_ERROR;
+    }
+    emu.except = exceptions ? &headless_exception : NULL;
+    emu.sfrwrite[REG_SBUF] = headless_sfrwrite_SBUF;
+
+    reset(&emu, 1);
+    decode_cache(&emu, 1);
+    jit_mode(&emu, JIT_ON);
+    emu.mBreakpoint = stop_pc;
+
+    if (load_obj(&emu, (char *)filename) != 0)
+    {
+        printf("File '%s' load failure\n", filename);
+        return EXIT_ERROR;
+    }
+    if (portfile)
+    {
+        if (read_inputs(portfile) != 0)
+            return EXIT_ERROR;
+        // only the scripted ports go through the callback
+        for (i = 0; i < input_count; i++)
+            emu.sfrread[port_reg[inputs[i].mPort]] = headless_sfrread;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do
+    {
+        uint64_t left = limit ? limit - emu.mCycles : 0x40000000;
+        run_cycles(&emu, left > 0x40000000 ? 0x40000000 : (uint32_t)left, &stop);
+    }
+    while (stop == STOP_BUDGET && (!limit || emu.mCycles < limit));
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    if (opt_serial)
+        printf("\n");
+    printf("Stopped: %s", stop_name(stop));
+    if (stop == STOP_EXCEPTION)
+        printf(" %d", emu.mException);
+    printf("\n");
+    print_state(&emu);
+    printf("%llu instructions, %llu cycles (%.6f s at %d Hz) in %.3f s: %.2f MIPS, %.2f MHz\n",
+        (unsigned long long)emu.mOperations, (unsigned long long)emu.mCycles,
+        (double)emu.mCycles * 12 / clock_hz, clock_hz, seconds,
+        seconds > 0 ? emu.mOperations / seconds / 1e6 : 0,
+        seconds > 0 ? emu.mCycles * 12 / seconds / 1e6 : 0);
+
+    if (stop == STOP_EXCEPTION)
+        return EXIT_EXCEPTION;
+    if (stop == STOP_BUDGET && stop_pc >= 0)
+        return EXIT_LIMIT;
+    return EXIT_STOP;
+}
@@ -0,0 +1,207 @@
+/* 8051 emulator core
+ * Copyright 2006 Jari Komppa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining 
+ * a copy of this software and associated documentation files (the 
+ * "Software"), to deal in the Software without restriction, including 
+ * without limitation the rights to use, copy, modify, merge, publish, 
+ * distribute, sublicense, and/or sell copies of the Software, and to 
+ * permit persons to whom the Software is furnished to do so, subject 
+ * to the following conditions: 
+ *
+ * The above copyright notice and this permission notice shall be included 
+ * in all copies or substantial portions of the Software. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+ * IN THE SOFTWARE. 
+ *
+ * (i.e. the MIT License)
+ *
+ * history.c
+ * Delta-encoded instruction history for the curses-based emulator front-end
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "emu8051.h"
+#include "emulator.h"
+
+/*
+    Each executed instruction appends one undo record to a byte
+    ring buffer:
+
+        count lo, count hi, pc lo, pc hi, (index, old value) * count, count lo, count hi
+
+    The index is into a 256 byte state image: SFRs (0x80..0xff) at
+    0..127, lower data at 128..255. Old values are the bytes as they
+    were before the instruction ran, so a past state is rebuilt by
+    walking backwards from the current image. The count is stored at
+    both ends so records can be walked from either end; the oldest
+    records are dropped when the buffer runs out of room.
+*/
+
+static unsigned char *log_buf = NULL;
+static unsigned int log_size = 0;
+// write position; the newest record ends here
+static unsigned int log_head = 0;
+// start of the oldest record
+static unsigned int log_tail = 0;
+static unsigned int log_used = 0;
+// number of records in the buffer
+static unsigned int log_records = 0;
+// state image as of the newest record
+static unsigned char shadow[256];
+
+// largest record: every byte of the state changed
+#define RECORD_MAX (6 + 2 * 256)
+
+int history_init(unsigned int aBytes)
+{
+    if (aBytes < RECORD_MAX)
+        aBytes = RECORD_MAX;
+    free(log_buf);
+    log_buf = malloc(aBytes);
+    if (log_buf == NULL)
+    {
+        log_size = 0;
+        return -1;
+    }
+    log_size = aBytes;
+    history_clear();
+    return 0;
+}
+
+void history_clear()
+{
+    log_head = 0;
+    log_tail = 0;
+    log_used = 0;
+    log_records = 0;
+    memset(shadow, 0, sizeof(shadow));
+}
+
+unsigned int history_depth()
+{
+    return log_records;
+}
+
+static void put(unsigned char aValue)
+{
+    log_buf[log_head] = aValue;
+    if (++log_head == log_size)
+        log_head = 0;
+}
+
+static unsigned char peek(unsigned int aPos)
+{
+    return log_buf[aPos % log_size];
+}
+
+// Appends (index, old value) pairs for bytes of aNew that differ from
+// the shadow, and updates the shadow
+static int diff(unsigned char *aChanges, int aCount, const uint8_t *aNew, int aBase)
+{
+    int i, j;
+    for (i = 0; i < 128; i += 8)
+    {
+        if (memcmp(aNew + i, shadow + aBase + i, 8) == 0)
+            continue;
+        for (j = i; j < i + 8; j++)
+        {
+            if (aNew[j] != shadow[aBase + j])
+            {
+                aChanges[aCount * 2] = aBase + j;
+                aChanges[aCount * 2 + 1] = shadow[aBase + j];
+                shadow[aBase + j] = aNew[j];
+                aCount++;
+            }
+        }
+    }
+    return aCount;
+}
+
+void history_record(struct em8051 *aCPU, uint16_t aPC)
+{
+    unsigned char changes[2 * 256];
+    unsigned int size;
+    int count, i;
+
+    if (log_buf == NULL)
+        return;
+
+    count = diff(changes, 0, aCPU->mSFR, 0);
+    count = diff(changes, count, aCPU->mLowerData, 128);
+    size = 6 + 2 * count;
+
+    while (log_used + size > log_size)
+    {
+        unsigned int oldest = peek(log_tail) | (peek(log_tail + 1) << 8);
+        log_tail = (log_tail + 6 + 2 * oldest) % log_size;
+        log_used -= 6 + 2 * oldest;
+        log_records--;
+    }
+
+    put(count & 0xff);
+    put(count >> 8);
+    put(aPC & 0xff);
+    put(aPC >> 8);
+    for (i = 0; i < count * 2; i++)
+        put(changes[i]);
+    put(count & 0xff);
+    put(count >> 8);
+
+    log_used += size;
+    log_records++;
+}
+
+void history_rewind(unsigned int aCount)
+{
+    while (aCount-- && log_records)
+    {
+        unsigned int pos = log_head + log_size;
+        unsigned int count = peek(pos - 2) | (peek(pos - 1) << 8);
+        unsigned int start = (pos - 6 - 2 * count) % log_size;
+        unsigned int i;
+
+        for (i = 0; i < count; i++)
+            shadow[peek(start + 4 + i * 2)] = peek(start + 5 + i * 2);
+        log_head = start;
+        log_used -= 6 + 2 * count;
+        log_records--;
+    }
+}
+
+int history_get(unsigned int aBack, int *aPC, unsigned char *aState)
+{
+    unsigned int pos = log_head + log_size;
+    unsigned int back;
+
+    if (aBack >= log_records)
+        return -1;
+
+    memcpy(aState, shadow, sizeof(shadow));
+
+    for (back = 0;; back++)
+    {
+        unsigned int count = peek(pos - 2) | (peek(pos - 1) << 8);
+        unsigned int start = pos - 6 - 2 * count;
+        unsigned int i;
+
+        if (back == aBack)
+        {
+            *aPC = peek(start + 2) | (peek(start + 3) << 8);
+            return 0;
+        }
+
+        // undo this record to get the state after the previous one
+        for (i = 0; i < count; i++)
+            aState[peek(start + 4 + i * 2)] = peek(start + 5 + i * 2);
+
+        pos = start % log_size + log_size;
+    }
+}
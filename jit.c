@@ -0,0 +1,475 @@
+/* 8051 emulator core
+ * Copyright 2006 Jari Komppa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining 
+ * a copy of this software and associated documentation files (the 
+ * "Software"), to deal in the Software without restriction, including 
+ * without limitation the rights to use, copy, modify, merge, publish, 
+ * distribute, sublicense, and/or sell copies of the Software, and to 
+ * permit persons to whom the Software is furnished to do so, subject 
+ * to the following conditions: 
+ *
+ * The above copyright notice and this permission notice shall be included 
+ * in all copies or substantial portions of the Software. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+ * IN THE SOFTWARE. 
+ *
+ * (i.e. the MIT License)
+ *
+ * jit.c
+ * Native code compiler for hot blocks (x86-64)
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "emu8051.h"
+
+#if defined(EM8051_JIT) && defined(__x86_64__) && !defined(_WIN32)
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Runs of a block before it gets compiled
+#define JIT_THRESHOLD 64
+// Size of the native code buffer; flushed when full
+#define JIT_BUFFER_SIZE (1024 * 1024)
+// Room needed to compile one block
+#define JIT_BLOCK_ROOM 1024
+// Count value of blocks that must not be compiled again
+#define JIT_NEVER 0xffff
+
+typedef uint8_t (*jitblock)(struct em8051 *aCPU);
+
+struct em8051jit
+{
+    int mMode;
+    uint8_t *mBuffer;
+    uint32_t mUsed;
+    jitblock *mCode; // compiled block by code memory address
+    uint16_t *mCount; // runs by code memory address
+};
+
+// Structure offsets used by the generated code
+#define OFS_PC offsetof(struct em8051, mPC)
+#define OFS_LOWER offsetof(struct em8051, mLowerData)
+#define OFS_SFR(r) (offsetof(struct em8051, mSFR) + (r))
+
+static uint8_t *emit8(uint8_t *p, uint8_t aValue)
+{
+    *p++ = aValue;
+    return p;
+}
+
+static uint8_t *emit16(uint8_t *p, uint16_t aValue)
+{
+    memcpy(p, &aValue, 2);
+    return p + 2;
+}
+
+static uint8_t *emit32(uint8_t *p, uint32_t aValue)
+{
+    memcpy(p, &aValue, 4);
+    return p + 4;
+}
+
+static uint8_t *emit64(uint8_t *p, uint64_t aValue)
+{
+    memcpy(p, &aValue, 8);
+    return p + 8;
+}
+
+// <op> [rbx + aOffset] with the ModRM reg field aReg
+static uint8_t *emit_mem(uint8_t *p, uint8_t aReg, uint32_t aOffset)
+{
+    p = emit8(p, 0x83 | (aReg << 3));
+    return emit32(p, aOffset);
+}
+
+// <op> [rbx + rax + aOffset] with the ModRM reg field aReg
+static uint8_t *emit_mem_rax(uint8_t *p, uint8_t aReg, uint32_t aOffset)
+{
+    p = emit8(p, 0x84 | (aReg << 3));
+    p = emit8(p, 0x03);
+    return emit32(p, aOffset);
+}
+
+// add word [rbx + mPC], aValue
+static uint8_t *emit_add_pc(uint8_t *p, uint16_t aValue)
+{
+    p = emit8(p, 0x66);
+    p = emit8(p, 0x81);
+    p = emit_mem(p, 0, OFS_PC);
+    return emit16(p, aValue);
+}
+
+// eax = bank base address, for Rn operations
+static uint8_t *emit_bank(uint8_t *p)
+{
+    // movzx eax, byte [psw]; and eax, 0x18
+    p = emit8(p, 0x0f);
+    p = emit8(p, 0xb6);
+    p = emit_mem(p, 0, OFS_SFR(REG_PSW));
+    p = emit8(p, 0x83);
+    p = emit8(p, 0xe0);
+    return emit8(p, PSWMASK_RS0 | PSWMASK_RS1);
+}
+
+// Relative branch taken when the flags say so: aSkip is the x86 jcc
+// opcode that skips the jump
+static uint8_t *emit_branch(uint8_t *p, uint8_t aSkip, uint16_t aOffset)
+{
+    p = emit8(p, aSkip);
+    p = emit8(p, 9); // length of the add below
+    return emit_add_pc(p, aOffset);
+}
+
+// Generates inline code for the simple operations. Returns NULL if the
+// operation has to call the interpreter's handler.
+static uint8_t *emit_inline(uint8_t *p, struct em8051decoded *aOp)
+{
+    uint8_t opcode = aOp->opcode;
+    uint8_t rx = opcode & 7;
+    uint16_t offset = (uint16_t)((signed char)aOp->operand[0]);
+
+    switch (opcode)
+    {
+    case 0x00: // nop
+        break;
+    case 0x74: // mov a, #data
+        p = emit8(p, 0xc6);
+        p = emit_mem(p, 0, OFS_SFR(REG_ACC));
+        p = emit8(p, aOp->operand[0]);
+        break;
+    case 0xe4: // clr a
+        p = emit8(p, 0xc6);
+        p = emit_mem(p, 0, OFS_SFR(REG_ACC));
+        p = emit8(p, 0);
+        break;
+    case 0xf4: // cpl a
+        p = emit8(p, 0xf6);
+        p = emit_mem(p, 2, OFS_SFR(REG_ACC));
+        break;
+    case 0x04: // inc a
+    case 0x14: // dec a
+        p = emit8(p, 0xfe);
+        p = emit_mem(p, opcode == 0x04 ? 0 : 1, OFS_SFR(REG_ACC));
+        break;
+    case 0xe8: case 0xe9: case 0xea: case 0xeb:
+    case 0xec: case 0xed: case 0xee: case 0xef: // mov a, rx
+        p = emit_bank(p);
+        p = emit8(p, 0x8a);
+        p = emit_mem_rax(p, 2, OFS_LOWER + rx);
+        p = emit8(p, 0x88);
+        p = emit_mem(p, 2, OFS_SFR(REG_ACC));
+        break;
+    case 0xf8: case 0xf9: case 0xfa: case 0xfb:
+    case 0xfc: case 0xfd: case 0xfe: case 0xff: // mov rx, a
+        p = emit_bank(p);
+        p = emit8(p, 0x8a);
+        p = emit_mem(p, 2, OFS_SFR(REG_ACC));
+        p = emit8(p, 0x88);
+        p = emit_mem_rax(p, 2, OFS_LOWER + rx);
+        break;
+    case 0x78: case 0x79: case 0x7a: case 0x7b:
+    case 0x7c: case 0x7d: case 0x7e: case 0x7f: // mov rx, #data
+        p = emit_bank(p);
+        p = emit8(p, 0xc6);
+        p = emit_mem_rax(p, 0, OFS_LOWER + rx);
+        p = emit8(p, aOp->operand[0]);
+        break;
+    case 0x08: case 0x09: case 0x0a: case 0x0b:
+    case 0x0c: case 0x0d: case 0x0e: case 0x0f: // inc rx
+    case 0x18: case 0x19: case 0x1a: case 0x1b:
+    case 0x1c: case 0x1d: case 0x1e: case 0x1f: // dec rx
+        p = emit_bank(p);
+        p = emit8(p, 0xfe);
+        p = emit_mem_rax(p, opcode < 0x10 ? 0 : 1, OFS_LOWER + rx);
+        break;
+    case 0x80: // sjmp offset
+        return emit_add_pc(p, offset + 2);
+    case 0x60: // jz offset
+    case 0x70: // jnz offset
+        p = emit_add_pc(p, 2);
+        p = emit8(p, 0x80);
+        p = emit_mem(p, 7, OFS_SFR(REG_ACC));
+        p = emit8(p, 0);
+        return emit_branch(p, opcode == 0x60 ? 0x75 : 0x74, offset);
+    case 0xd8: case 0xd9: case 0xda: case 0xdb:
+    case 0xdc: case 0xdd: case 0xde: case 0xdf: // djnz rx, offset
+        p = emit_bank(p);
+        p = emit_add_pc(p, 2);
+        p = emit8(p, 0xfe);
+        p = emit_mem_rax(p, 1, OFS_LOWER + rx);
+        return emit_branch(p, 0x74, offset);
+    default:
+        return NULL;
+    }
+    return emit_add_pc(p, aOp->length);
+}
+
+// Ticks value returned by the inlined operations
+static uint8_t inline_ticks(uint8_t aOpcode)
+{
+    switch (aOpcode)
+    {
+    case 0x80: case 0x60: case 0x70:
+    case 0xd8: case 0xd9: case 0xda: case 0xdb:
+    case 0xdc: case 0xdd: case 0xde: case 0xdf:
+        return 1;
+    }
+    return 0;
+}
+
+// The buffer is never writable and executable at the same time: the pages
+// a block is emitted into are made writable for the time it takes, then
+// read-only and executable
+static bool protect(struct em8051jit *aJit, uint32_t aOffset, int aProt)
+{
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)(aJit->mBuffer + aOffset) & ~(page - 1);
+    uintptr_t end = (uintptr_t)(aJit->mBuffer + aOffset + JIT_BLOCK_ROOM);
+    return mprotect((void *)start, end - start, aProt) == 0;
+}
+
+// Returns NULL if the buffer can't be made writable or executable
+static jitblock compile_block(struct em8051 *aCPU, struct em8051decoded *aBlock)
+{
+    struct em8051jit *jit = aCPU->mJit;
+    uint8_t *start = jit->mBuffer + jit->mUsed;
+    uint8_t *p = start;
+    uint16_t pc = aCPU->mPC;
+    int i;
+
+    if (!protect(jit, jit->mUsed, PROT_READ | PROT_WRITE))
+        return NULL;
+
+    // push rbx; mov rbx, rdi
+    p = emit8(p, 0x53);
+    p = emit8(p, 0x48);
+    p = emit8(p, 0x89);
+    p = emit8(p, 0xfb);
+
+    for (i = 0; i < aBlock->block_ops; i++)
+    {
+        struct em8051decoded *d = &aCPU->mDecoded[pc & aCPU->mCodeMemMaxIdx];
+        bool last = i == aBlock->block_ops - 1;
+        uint8_t *q;
+
+        if (!d->op)
+            d = decode_operation(aCPU, pc);
+
+        q = emit_inline(p, d);
+        if (q)
+        {
+            p = q;
+            if (last)
+            {
+                // mov eax, ticks
+                p = emit8(p, 0xb8);
+                p = emit32(p, inline_ticks(d->opcode));
+            }
+        }
+        else
+        {
+            // mov rdi, rbx; mov rax, handler; call rax
+            p = emit8(p, 0x48);
+            p = emit8(p, 0x89);
+            p = emit8(p, 0xdf);
+            p = emit8(p, 0x48);
+            p = emit8(p, 0xb8);
+            p = emit64(p, (uint64_t)(uintptr_t)d->op);
+            p = emit8(p, 0xff);
+            p = emit8(p, 0xd0);
+        }
+        pc += d->length;
+    }
+
+    // pop rbx; ret
+    p = emit8(p, 0x5b);
+    p = emit8(p, 0xc3);
+
+    if (!protect(jit, jit->mUsed, PROT_READ | PROT_EXEC))
+        return NULL;
+    jit->mUsed += p - start;
+    return (jitblock)(uintptr_t)start;
+}
+
+static void flush(struct em8051 *aCPU)
+{
+    struct em8051jit *jit = aCPU->mJit;
+    memset(jit->mCode, 0, (aCPU->mCodeMemMaxIdx + 1) * sizeof(jitblock));
+    memset(jit->mCount, 0, (aCPU->mCodeMemMaxIdx + 1) * sizeof(uint16_t));
+    jit->mUsed = 0;
+}
+
+// Runs the block both ways and compares the results. The interpreter's
+// result is kept.
+static uint8_t verify(struct em8051 *aCPU, struct em8051decoded *aBlock, jitblock aCode)
+{
+    unsigned char lower[128], upper[128], sfr[128];
+    unsigned char native_lower[128], native_upper[128], native_sfr[128];
+    uint16_t pc = aCPU->mPC;
+    uint16_t native_pc;
+    uint8_t native_ticks, ticks;
+    bool mismatch;
+
+    update_flags(aCPU);
+    memcpy(lower, aCPU->mLowerData, 128);
+    memcpy(sfr, aCPU->mSFR, 128);
+    if (aCPU->mUpperData)
+        memcpy(upper, aCPU->mUpperData, 128);
+
+    native_ticks = aCode(aCPU);
+    update_flags(aCPU);
+    native_pc = aCPU->mPC;
+    memcpy(native_lower, aCPU->mLowerData, 128);
+    memcpy(native_sfr, aCPU->mSFR, 128);
+    if (aCPU->mUpperData)
+        memcpy(native_upper, aCPU->mUpperData, 128);
+
+    memcpy(aCPU->mLowerData, lower, 128);
+    memcpy(aCPU->mSFR, sfr, 128);
+    if (aCPU->mUpperData)
+        memcpy(aCPU->mUpperData, upper, 128);
+    aCPU->mPC = pc;
+
+    ticks = run_block_ops(aCPU, aBlock);
+    update_flags(aCPU);
+
+    mismatch = (!native_ticks != !ticks) ||
+        native_pc != aCPU->mPC ||
+        memcmp(native_lower, aCPU->mLowerData, 128) ||
+        memcmp(native_sfr, aCPU->mSFR, 128) ||
+        (aCPU->mUpperData && memcmp(native_upper, aCPU->mUpperData, 128));
+
+    if (mismatch)
+    {
+        // don't trust this block again
+        aCPU->mJit->mCode[pc & aCPU->mCodeMemMaxIdx] = NULL;
+        aCPU->mJit->mCount[pc & aCPU->mCodeMemMaxIdx] = JIT_NEVER;
+        aCPU->mException = EXCEPTION_JIT_MISMATCH;
+        if (aCPU->except)
+            aCPU->except(aCPU, EXCEPTION_JIT_MISMATCH);
+    }
+    return ticks;
+}
+
+bool jit_run(struct em8051 *aCPU, struct em8051decoded *aBlock, uint8_t *aTicks)
+{
+    struct em8051jit *jit = aCPU->mJit;
+    uint16_t address = aCPU->mPC & aCPU->mCodeMemMaxIdx;
+    jitblock code = jit->mCode[address];
+
+    if (!code)
+    {
+        if (jit->mCount[address] == JIT_NEVER ||
+            ++jit->mCount[address] < JIT_THRESHOLD)
+            return false;
+
+        if (jit->mUsed + JIT_BLOCK_ROOM > JIT_BUFFER_SIZE)
+            flush(aCPU);
+        code = compile_block(aCPU, aBlock);
+        if (!code)
+        {
+            jit->mCount[address] = JIT_NEVER;
+            return false;
+        }
+        jit->mCode[address] = code;
+    }
+
+    if (jit->mMode == JIT_VERIFY)
+        *aTicks = verify(aCPU, aBlock, code);
+    else
+        *aTicks = code(aCPU);
+    return true;
+}
+
+void jit_invalidate(struct em8051 *aCPU, uint16_t aAddress, uint32_t aLength)
+{
+    struct em8051jit *jit = aCPU->mJit;
+    uint32_t i;
+
+    if (aLength > aCPU->mCodeMemMaxIdx)
+    {
+        flush(aCPU);
+        return;
+    }
+
+    // blocks starting up to BLOCK_MAX_OPS operations earlier cover the area
+    // (the code itself stays in the buffer until the next flush)
+    for (i = 0; i < aLength + 2 + BLOCK_MAX_OPS * 3; i++)
+    {
+        uint16_t address = (aAddress - 2 - BLOCK_MAX_OPS * 3 + i) & aCPU->mCodeMemMaxIdx;
+        jit->mCode[address] = NULL;
+        jit->mCount[address] = 0;
+    }
+}
+
+bool jit_mode(struct em8051 *aCPU, int aMode)
+{
+    struct em8051jit *jit = aCPU->mJit;
+
+    if (aMode == JIT_OFF)
+    {
+        if (jit)
+        {
+            munmap(jit->mBuffer, JIT_BUFFER_SIZE);
+            free(jit->mCode);
+            free(jit->mCount);
+            free(jit);
+            aCPU->mJit = NULL;
+        }
+        return true;
+    }
+
+    if (!aCPU->mDecoded)
+        return false;
+
+    if (!jit)
+    {
+        jit = calloc(1, sizeof(struct em8051jit));
+        if (!jit)
+            return false;
+        jit->mBuffer = mmap(NULL, JIT_BUFFER_SIZE, PROT_READ,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        jit->mCode = calloc(aCPU->mCodeMemMaxIdx + 1, sizeof(jitblock));
+        jit->mCount = calloc(aCPU->mCodeMemMaxIdx + 1, sizeof(uint16_t));
+        if (jit->mBuffer == MAP_FAILED || !jit->mCode || !jit->mCount)
+        {
+            if (jit->mBuffer != MAP_FAILED)
+                munmap(jit->mBuffer, JIT_BUFFER_SIZE);
+            free(jit->mCode);
+            free(jit->mCount);
+            free(jit);
+            return false;
+        }
+        aCPU->mJit = jit;
+    }
+    jit->mMode = aMode;
+    return true;
+}
+
+#else // no JIT in this build
+
+bool jit_run(struct em8051 *aCPU, struct em8051decoded *aBlock, uint8_t *aTicks)
+{
+    return false;
+}
+
+void jit_invalidate(struct em8051 *aCPU, uint16_t aAddress, uint32_t aLength)
+{
+}
+
+bool jit_mode(struct em8051 *aCPU, int aMode)
+{
+    return aMode == JIT_OFF;
+}
+
+#endif
@@ -275,12 +275,46 @@ void setregoutput(struct em8051 *aCPU, int pos, int val)
 }
 
 
+// The emulator was taken back aOps operations, from tick aCycles
+static void went_back(struct em8051 *aCPU, uint64_t aCycles, int aOps)
+{
+    unsigned int back = 12 * (unsigned int)(aCycles - aCPU->mCycles);
+
+    runmode = 0;
+    setSpeed(speed, runmode);
+    icount -= aOps;
+    history_rewind(aOps);
+    clocks = clocks > back ? clocks - back : 0;
+    refreshview(aCPU);
+}
+
 void mainview_editor_keys(struct em8051 *aCPU, int ch)
 {
     int insert_value = -1;
     int maxmem;
+    uint64_t cycles = aCPU->mCycles;
+    int ops;
     switch(ch)
     {
+    case 'u':
+        ops = checkpoints_step_back(&checkpoints, aCPU);
+        if (ops)
+            went_back(aCPU, cycles, ops);
+        else
+            emu_popup(aCPU, "Step back", "Nothing older to go back to.");
+        break;
+    case 'U':
+        if (aCPU->mBreakpoint == -1)
+        {
+            emu_popup(aCPU, "Back to breakpoint", "No breakpoint set.");
+            break;
+        }
+        ops = checkpoints_reverse_continue(&checkpoints, aCPU);
+        if (ops)
+            went_back(aCPU, cycles, ops);
+        else
+            emu_popup(aCPU, "Back to breakpoint", "Not hit within the checkpoints.");
+        break;
     case KEY_NEXT:
     case '\t':
         cursorpos = 0;
@@ -430,6 +464,8 @@ void mainview_editor_keys(struct em8051 *aCPU, int ch)
             if (cursorpos > 23)
                 cursorpos = 23;
         }
+        // the past no longer leads here
+        checkpoints_clear(&checkpoints, aCPU);
     }
 
     while (memcursorpos < 0)
@@ -500,7 +536,6 @@ void mainview_update(struct em8051 *aCPU)
     int opcode_bytes;
     int stringpos;
     int rx;
-    unsigned int hline;
 
     if ((speed != 0 || !runmode) && lastclock != icount)
     {
@@ -508,21 +543,19 @@ void mainview_update(struct em8051 *aCPU)
         if (icount - lastclock > HISTORY_LINES)
             lastclock = icount - HISTORY_LINES;
 
-        // + HISTORY_LINES to force positive result
-        hline = historyline - (icount - lastclock) + HISTORY_LINES;
-
         while (lastclock != icount)
         {
             char assembly[128];
             char temp[256];
             int old_pc;
-            int hoffs;
-            
-            hline = (hline + 1) % HISTORY_LINES;
+            unsigned char h[256];
 
-            hoffs = (hline * (128 + 64 + sizeof(int)));
+            if (history_get(icount - lastclock - 1, &old_pc, h) != 0)
+            {
+                lastclock++;
+                continue;
+            }
 
-            memcpy(&old_pc, history + hoffs + 128 + 64, sizeof(int));
             opcode_bytes = decode(aCPU, old_pc, assembly);
             stringpos = 0;
             stringpos += sprintf(temp + stringpos,"\n%04X  ", old_pc & 0xffff);
@@ -537,54 +570,54 @@ void mainview_update(struct em8051 *aCPU)
 
             wprintw(codeoutput, "%s", temp);
 
-            rx = 8 * ((history[hoffs + REG_PSW] & (PSWMASK_RS0|PSWMASK_RS1))>>PSW_RS0);
+            rx = 8 * ((h[REG_PSW] & (PSWMASK_RS0|PSWMASK_RS1))>>PSW_RS0);
             
             sprintf(temp, "\n%02X %02X %02X %02X %02X %02X %02X %02X %02X %02X %04X",
-                history[hoffs + REG_ACC],
-                history[hoffs + 128 + 0 + rx],
-                history[hoffs + 128 + 1 + rx],
-                history[hoffs + 128 + 2 + rx],
-                history[hoffs + 128 + 3 + rx],
-                history[hoffs + 128 + 4 + rx],
-                history[hoffs + 128 + 5 + rx],
-                history[hoffs + 128 + 6 + rx],
-                history[hoffs + 128 + 7 + rx],
-                history[hoffs + REG_B],
-                (history[hoffs + REG_DPH]<<8)|history[hoffs + REG_DPL]);
+                h[REG_ACC],
+                h[128 + 0 + rx],
+                h[128 + 1 + rx],
+                h[128 + 2 + rx],
+                h[128 + 3 + rx],
+                h[128 + 4 + rx],
+                h[128 + 5 + rx],
+                h[128 + 6 + rx],
+                h[128 + 7 + rx],
+                h[REG_B],
+                (h[REG_DPH]<<8)|h[REG_DPL]);
             if (focus == 1)
                 refresh_regoutput(aCPU, 0);
             wprintw(regoutput,"%s",temp);
 
             sprintf(temp, "\n%d %d %d %d %d %d %d %d",
-                (history[hoffs + REG_PSW] >> 7) & 1,
-                (history[hoffs + REG_PSW] >> 6) & 1,
-                (history[hoffs + REG_PSW] >> 5) & 1,
-                (history[hoffs + REG_PSW] >> 4) & 1,
-                (history[hoffs + REG_PSW] >> 3) & 1,
-                (history[hoffs + REG_PSW] >> 2) & 1,
-                (history[hoffs + REG_PSW] >> 1) & 1,
-                (history[hoffs + REG_PSW] >> 0) & 1);
+                (h[REG_PSW] >> 7) & 1,
+                (h[REG_PSW] >> 6) & 1,
+                (h[REG_PSW] >> 5) & 1,
+                (h[REG_PSW] >> 4) & 1,
+                (h[REG_PSW] >> 3) & 1,
+                (h[REG_PSW] >> 2) & 1,
+                (h[REG_PSW] >> 1) & 1,
+                (h[REG_PSW] >> 0) & 1);
             wprintw(pswoutput,"%s",temp);
 
             sprintf(temp, "\n%02X %02X %02X %02X %02X %02X %02X",
-                history[hoffs + REG_SP],
-                history[hoffs + REG_P0],
-                history[hoffs + REG_P1],
-                history[hoffs + REG_P2],
-                history[hoffs + REG_P3],
-                history[hoffs + REG_IP],
-                history[hoffs + REG_IE]);
+                h[REG_SP],
+                h[REG_P0],
+                h[REG_P1],
+                h[REG_P2],
+                h[REG_P3],
+                h[REG_IP],
+                h[REG_IE]);
             wprintw(ioregoutput,"%s",temp);
 
             sprintf(temp, "\n%02X   %02X    %02X  %02X   %02X  %02X   %02X   %02X",
-                history[hoffs + REG_TMOD],
-                history[hoffs + REG_TCON],
-                history[hoffs + REG_TH0],
-                history[hoffs + REG_TL0],
-                history[hoffs + REG_TH1],
-                history[hoffs + REG_TL1],
-                history[hoffs + REG_SCON],
-                history[hoffs + REG_PCON]);
+                h[REG_TMOD],
+                h[REG_TCON],
+                h[REG_TH0],
+                h[REG_TL0],
+                h[REG_TH1],
+                h[REG_TL1],
+                h[REG_SCON],
+                h[REG_PCON]);
             wprintw(spregoutput, "%s", temp);
 
             lastclock++;
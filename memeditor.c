@@ -204,6 +204,10 @@ void memeditor_editor_keys(struct em8051 *aCPU, int ch)
             eds[focus].memarea[eds[focus].memoffset + (eds[focus].cursorpos / 2)] = (eds[focus].memarea[eds[focus].memoffset + (eds[focus].cursorpos / 2)] & 0xf0) | insert_value;
         else
             eds[focus].memarea[eds[focus].memoffset + (eds[focus].cursorpos / 2)] = (eds[focus].memarea[eds[focus].memoffset + (eds[focus].cursorpos / 2)] & 0x0f) | (insert_value << 4);
+        if (eds[focus].memarea == aCPU->mCodeMem)
+            invalidate_code(aCPU, eds[focus].memoffset + (eds[focus].cursorpos / 2), 1);
+        // the past no longer leads here
+        checkpoints_clear(&checkpoints, aCPU);
         eds[focus].cursorpos++;
     }
 
@@ -31,30 +31,127 @@
 #include <string.h>
 #include "emu8051.h"
 
+// This file is also compiled with the memory configuration fixed at compile
+// time (see opcodes8052.c etc.); CORE_NAME() then names the handler tables
+// after the variant. Built on its own it is the generic core, which works
+// out the memory sizes at run time.
+#ifndef EM8051_CORE_VARIANT
+#define CORE_NAME(name) name
+#define CODE_MASK (aCPU->mCodeMemMaxIdx)
+#define XDATA_MASK (aCPU->mExtDataMaxIdx)
+#define HAS_UPPER_DATA (aCPU->mUpperData != NULL)
+#else
+#define push_to_stack CORE_NAME(push_to_stack)
+#endif
+
 #define BAD_VALUE 0x77
-#define PSW aCPU->mSFR[REG_PSW]
+#define PSW (*psw(aCPU))
 #define ACC aCPU->mSFR[REG_ACC]
 #define DPTR ((aCPU->mSFR[REG_DPH] << 8) | (aCPU->mSFR[REG_DPL]))
 #define PC aCPU->mPC
-#define CODEMEM(x) aCPU->mCodeMem[(x)&(aCPU->mCodeMemMaxIdx)]
-#define EXTDATA(x) aCPU->mExtData[(x)&(aCPU->mExtDataMaxIdx)]
+#define CODEMEM(x) aCPU->mCodeMem[(x)&CODE_MASK]
+#define EXTDATA(x) aCPU->mExtData[(x)&XDATA_MASK]
 #define UPRDATA(x) aCPU->mUpperData[(x) - 0x80]
 #define OPCODE CODEMEM(PC + 0)
 #define OPERAND1 CODEMEM(PC + 1)
 #define OPERAND2 CODEMEM(PC + 2)
-#define PSW_BANK ((PSW & (PSWMASK_RS0|PSWMASK_RS1))>>PSW_RS0)
-#define INDIR_RX_ADDRESS (aCPU->mLowerData[(OPCODE & 1) + 8 * PSW_BANK])
-#define RX_ADDRESS ((OPCODE & 7) + 8 * PSW_BANK)
-#define CARRY ((PSW & PSWMASK_C) >> PSW_C)
+// RS1:RS0 are PSW bits 4:3, so the masked PSW is the bank's offset in
+// mLowerData as it is
+#define BANK_OFFSET (aCPU->mSFR[REG_PSW] & (PSWMASK_RS0|PSWMASK_RS1))
+// aRx is the register number, a constant in the handler made for each
+// register (see RX_HANDLERS); those have to be inlined for that to matter
+#if defined(__GNUC__)
+#define FORCE_INLINE static inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define FORCE_INLINE static __forceinline
+#else
+#define FORCE_INLINE static inline
+#endif
+#define INDIR_RX_ADDRESS (aCPU->mLowerData[aRx + BANK_OFFSET])
+#define RX_ADDRESS (aRx + BANK_OFFSET)
+#define CARRY carry_flag(aCPU)
+
+// PSW with any pending arithmetic flags written in
+static uint8_t *psw(struct em8051 *aCPU)
+{
+    if (aCPU->mFlagOp != FLAGS_NONE)
+        update_flags(aCPU);
+    return &aCPU->mSFR[REG_PSW];
+}
+
+// Carry flag, without writing pending flags into PSW; an ADDC chain
+// only needs the carry of the previous step
+static bool carry_flag(struct em8051 *aCPU)
+{
+    uint8_t value1 = aCPU->mFlagValue[0];
+    uint8_t value2 = aCPU->mFlagValue[1];
+
+    switch (aCPU->mFlagOp)
+    {
+    case FLAGS_ADD:
+        return (value1 + value2 + aCPU->mFlagCarry) >> 8;
+    case FLAGS_SUB:
+        return ((value1 - value2 - aCPU->mFlagCarry) >> 8) & 1;
+    }
+    return (aCPU->mSFR[REG_PSW] & PSWMASK_C) >> PSW_C;
+}
+
+// Brings PSW and the timers up to date before an SFR is changed directly
+static void sync_sfr(struct em8051 *aCPU, uint8_t aAddress)
+{
+    if (aAddress == REG_PSW + 0x80 && aCPU->mFlagOp != FLAGS_NONE)
+        update_flags(aCPU);
+    if ((aAddress >= REG_TCON + 0x80 && aAddress <= REG_TH1 + 0x80) ||
+        aAddress == REG_SCON + 0x80)
+        timer_changed(aCPU);
+}
+
+// Picks up changes to the interrupt registers after an SFR is written
+static void sfr_written(struct em8051 *aCPU, uint8_t aAddress)
+{
+    if (aAddress == REG_TCON + 0x80 || aAddress == REG_IE + 0x80 || aAddress == REG_IP + 0x80)
+        interrupt_update(aCPU);
+}
+
+// Reads through the callbacks go through the checkpoint log when there
+// is one, so replays get the same values
+static uint8_t sfr_callback(struct em8051 *aCPU, uint8_t aAddress)
+{
+    if (aCPU->mCheckpoints)
+        return checkpoints_sfrread(aCPU, aAddress);
+    return aCPU->sfrread[aAddress - 0x80](aCPU, aAddress);
+}
+
+static uint8_t xdata_callback(struct em8051 *aCPU, em8051xread aRead, uint16_t aAddress)
+{
+    if (aCPU->mCheckpoints)
+        return checkpoints_xread(aCPU, aRead, aAddress);
+    return aRead(aCPU, aAddress);
+}
+
+static uint8_t read_sfr(struct em8051 *aCPU, uint8_t aAddress)
+{
+    // run_cycles() leaves the parity bit for whoever reads PSW to update
+    if (aAddress == REG_PSW + 0x80)
+    {
+        update_parity(aCPU);
+        sync_sfr(aCPU, aAddress);
+    }
+    // timer counts are only brought up to date when looked at; flags only
+    // change on timer events, which are never late
+    if (aAddress >= REG_TL0 + 0x80 && aAddress <= REG_TH1 + 0x80)
+        timer_sync(aCPU);
+    return aCPU->mSFR[aAddress - 0x80];
+}
 
 static uint8_t read_mem(struct em8051 *aCPU, uint8_t aAddress)
 {
     if (aAddress > 0x7f)
     {
         if (aCPU->sfrread[aAddress - 0x80])
-            return aCPU->sfrread[aAddress - 0x80](aCPU, aAddress);
+            return sfr_callback(aCPU, aAddress);
         else
-            return aCPU->mSFR[aAddress - 0x80];
+            return read_sfr(aCPU, aAddress);
     }
     else
     {
@@ -66,7 +163,7 @@ static uint8_t read_mem_indir(struct em8051 *aCPU, uint8_t aAddress)
 {
     if (aAddress > 0x7f)
     {
-	if (aCPU->mUpperData)
+	if (HAS_UPPER_DATA)
 	{
 		return aCPU->mUpperData[aAddress - 0x80];
 	}
@@ -83,7 +180,9 @@ static void write_mem(struct em8051 *aCPU, uint8_t aAddress, uint8_t value)
 {
     if (aAddress > 0x7f)
     {
+        sync_sfr(aCPU, aAddress);
         aCPU->mSFR[aAddress - 0x80] = value;
+        sfr_written(aCPU, aAddress);
         if (aCPU->sfrwrite[aAddress - 0x80])
             aCPU->sfrwrite[aAddress - 0x80](aCPU, aAddress);
     }
@@ -97,7 +196,7 @@ static void write_mem_indir(struct em8051 *aCPU, uint8_t aAddress, uint8_t value
 {
     if (aAddress > 0x7f)
     {
-	if (aCPU->mUpperData)
+	if (HAS_UPPER_DATA)
 	{
 		aCPU->mUpperData[aAddress - 0x80] = value;
 	}
@@ -108,13 +207,86 @@ static void write_mem_indir(struct em8051 *aCPU, uint8_t aAddress, uint8_t value
     }
 }
 
+// Byte and mask of each bit address: internal RAM 0x20-0x2f for bit
+// addresses below 0x80, every eighth SFR from 0x80 up for the rest
+struct em8051bit
+{
+    uint8_t address; // direct address of the byte
+    uint8_t mask;
+};
+
+#define BIT_BYTE(a) \
+    {a, 0x01}, {a, 0x02}, {a, 0x04}, {a, 0x08}, {a, 0x10}, {a, 0x20}, {a, 0x40}, {a, 0x80}
+
+static const struct em8051bit bit_table[256] =
+{
+    BIT_BYTE(0x20), BIT_BYTE(0x21), BIT_BYTE(0x22), BIT_BYTE(0x23),
+    BIT_BYTE(0x24), BIT_BYTE(0x25), BIT_BYTE(0x26), BIT_BYTE(0x27),
+    BIT_BYTE(0x28), BIT_BYTE(0x29), BIT_BYTE(0x2a), BIT_BYTE(0x2b),
+    BIT_BYTE(0x2c), BIT_BYTE(0x2d), BIT_BYTE(0x2e), BIT_BYTE(0x2f),
+    BIT_BYTE(0x80), BIT_BYTE(0x88), BIT_BYTE(0x90), BIT_BYTE(0x98),
+    BIT_BYTE(0xa0), BIT_BYTE(0xa8), BIT_BYTE(0xb0), BIT_BYTE(0xb8),
+    BIT_BYTE(0xc0), BIT_BYTE(0xc8), BIT_BYTE(0xd0), BIT_BYTE(0xd8),
+    BIT_BYTE(0xe0), BIT_BYTE(0xe8), BIT_BYTE(0xf0), BIT_BYTE(0xf8)
+};
+
+// Value of a bit; SFRs are read like bytes, through the read callback
+static inline bool read_bit(struct em8051 *aCPU, uint8_t aBit)
+{
+    const struct em8051bit *bit = &bit_table[aBit];
+    uint8_t value;
+    if (bit->address < 0x80)
+        value = aCPU->mLowerData[bit->address];
+    else if (aCPU->sfrread[bit->address - 0x80])
+        value = sfr_callback(aCPU, bit->address);
+    else
+        value = read_sfr(aCPU, bit->address);
+    return (value & bit->mask) != 0;
+}
+
+// Value of a bit as held in the SFR latch, for read-modify-write
+static inline bool latch_bit(struct em8051 *aCPU, uint8_t aBit)
+{
+    const struct em8051bit *bit = &bit_table[aBit];
+    if (bit->address < 0x80)
+        return (aCPU->mLowerData[bit->address] & bit->mask) != 0;
+    return (read_sfr(aCPU, bit->address) & bit->mask) != 0;
+}
+
+// Clears and/or flips a bit. SFRs are brought up to date and changed in
+// the latch, then the write callback is told.
+static inline void modify_bit(struct em8051 *aCPU, uint8_t aBit, bool aClear, bool aFlip)
+{
+    const struct em8051bit *bit = &bit_table[aBit];
+    uint8_t clear = aClear ? bit->mask : 0;
+    uint8_t flip = aFlip ? bit->mask : 0;
+
+    if (bit->address < 0x80)
+    {
+        aCPU->mLowerData[bit->address] = (aCPU->mLowerData[bit->address] & ~clear) ^ flip;
+        return;
+    }
+    sync_sfr(aCPU, bit->address);
+    aCPU->mSFR[bit->address - 0x80] = (aCPU->mSFR[bit->address - 0x80] & ~clear) ^ flip;
+    sfr_written(aCPU, bit->address);
+    if (aCPU->sfrwrite[bit->address - 0x80])
+        aCPU->sfrwrite[bit->address - 0x80](aCPU, bit->address);
+}
+
+static void exception(struct em8051 *aCPU, int aCode)
+{
+    // remember the code so run_cycles() can stop the batch
+    aCPU->mException = aCode;
+    aCPU->except(aCPU, aCode);
+}
+
 void push_to_stack(struct em8051 *aCPU, uint8_t aValue)
 {
     aCPU->mSFR[REG_SP]++;
     write_mem(aCPU, aCPU->mSFR[REG_SP], aValue);
     if (aCPU->mSFR[REG_SP] == 0)
         if (aCPU->except)
-            aCPU->except(aCPU, EXCEPTION_STACK);
+            exception(aCPU, EXCEPTION_STACK);
 }
 
 static uint8_t pop_from_stack(struct em8051 *aCPU)
@@ -124,33 +296,26 @@ static uint8_t pop_from_stack(struct em8051 *aCPU)
 
     if (aCPU->mSFR[REG_SP] == 0xff)
         if (aCPU->except)
-            aCPU->except(aCPU, EXCEPTION_STACK);
+            exception(aCPU, EXCEPTION_STACK);
     return value;
 }
 
 
+// C, AC and OV are worked out by update_flags() once someone looks at PSW
 static void add_solve_flags(struct em8051 * aCPU, uint8_t value1, uint8_t value2, bool carryin)
 {
-    /* Carry: overflow from 7th bit to 8th bit */
-    bool carry = ((value1 & 255) + (value2 & 255) + carryin) >> 8;
-    
-    /* Auxiliary carry: overflow from 3th bit to 4th bit */
-    bool auxcarry = ((value1 & 7) + (value2 & 7) + carryin) >> 3;
-    
-    /* Overflow: overflow from 6th or 7th bit, but not both */
-    bool overflow = (((value1 & 127) + (value2 & 127) + carryin) >> 7)^carry;
-    
-    PSW = (PSW & ~(PSWMASK_C | PSWMASK_AC | PSWMASK_OV)) |
-          (carry << PSW_C) | (auxcarry << PSW_AC) | (overflow << PSW_OV);
+    aCPU->mFlagOp = FLAGS_ADD;
+    aCPU->mFlagValue[0] = value1;
+    aCPU->mFlagValue[1] = value2;
+    aCPU->mFlagCarry = carryin;
 }
 
 static void sub_solve_flags(struct em8051 * aCPU, uint8_t value1, uint8_t value2, bool carryin)
 {
-    bool carry = (((value1 & 255) - (value2 & 255) - carryin) >> 8) & 1;
-    bool auxcarry = (((value1 & 7) - (value2 & 7) - carryin) >> 3) & 1;
-    bool overflow = ((((value1 & 127) - (value2 & 127) - carryin) >> 7) & 1)^carry;
-    PSW = (PSW & ~(PSWMASK_C|PSWMASK_AC|PSWMASK_OV)) |
-                          (carry << PSW_C) | (auxcarry << PSW_AC) | (overflow << PSW_OV);
+    aCPU->mFlagOp = FLAGS_SUB;
+    aCPU->mFlagValue[0] = value1;
+    aCPU->mFlagValue[1] = value2;
+    aCPU->mFlagCarry = carryin;
 }
 
 
@@ -197,7 +362,7 @@ static uint8_t inc_mem(struct em8051 *aCPU)
     return 0;
 }
 
-static uint8_t inc_indir_rx(struct em8051 *aCPU)
+FORCE_INLINE uint8_t inc_indir_rx(struct em8051 *aCPU, uint8_t aRx)
 {    
     uint8_t address = INDIR_RX_ADDRESS;
     uint8_t value = read_mem_indir(aCPU, address);
@@ -212,41 +377,14 @@ static uint8_t jbc_bitaddr_offset(struct em8051 *aCPU)
     // as the original data will be read from the output data latch, not the input pin
     // -- MCS(r) 51 Microcontroller Family User's Manual
     uint8_t address = OPERAND1;
-    if (address > 0x7f)
+    if (latch_bit(aCPU, address))
     {
-        uint8_t bitaddr = address & 7;
-        uint8_t bitmask = (1 << bitaddr);
-        uint8_t value;
-        address &= 0xf8;        
-        value = aCPU->mSFR[address - 0x80];
-        
-        if (value & bitmask)
-        {
-            aCPU->mSFR[address - 0x80] &= ~bitmask;
-            PC += (signed char)OPERAND2 + 3;
-            if (aCPU->sfrwrite[address - 0x80])
-                aCPU->sfrwrite[address - 0x80](aCPU, address);
-        }
-        else
-        {
-            PC += 3;
-        }
+        modify_bit(aCPU, address, true, false);
+        PC += (signed char)OPERAND2 + 3;
     }
     else
     {
-        uint8_t bitaddr = address & 7;
-        uint8_t bitmask = (1 << bitaddr);
-        address >>= 3;
-        address += 0x20;
-        if (aCPU->mLowerData[address] & bitmask)
-        {
-            aCPU->mLowerData[address] &= ~bitmask;
-            PC += (signed char)OPERAND2 + 3;
-        }
-        else
-        {
-            PC += 3;
-        }
+        PC += 3;
     }
     return 1;
 }
@@ -295,7 +433,7 @@ static uint8_t dec_mem(struct em8051 *aCPU)
     return 0;
 }
 
-static uint8_t dec_indir_rx(struct em8051 *aCPU)
+FORCE_INLINE uint8_t dec_indir_rx(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t address = INDIR_RX_ADDRESS;
     uint8_t value = read_mem_indir(aCPU, address);
@@ -307,41 +445,13 @@ static uint8_t dec_indir_rx(struct em8051 *aCPU)
 
 static uint8_t jb_bitaddr_offset(struct em8051 *aCPU)
 {
-    uint8_t address = OPERAND1;
-    if (address > 0x7f)
+    if (read_bit(aCPU, OPERAND1))
     {
-        uint8_t bitaddr = address & 7;
-        uint8_t bitmask = (1 << bitaddr);
-        uint8_t value;
-        address &= 0xf8;        
-        if (aCPU->sfrread[address - 0x80])
-            value = aCPU->sfrread[address - 0x80](aCPU, address);
-        else
-            value = aCPU->mSFR[address - 0x80];
-        
-        if (value & bitmask)
-        {
-            PC += (signed char)OPERAND2 + 3;
-        }
-        else
-        {
-            PC += 3;
-        }
+        PC += (signed char)OPERAND2 + 3;
     }
     else
     {
-        uint8_t bitaddr = address & 7;
-        uint8_t bitmask = (1 << bitaddr);
-        address >>= 3;
-        address += 0x20;
-        if (aCPU->mLowerData[address] & bitmask)
-        {
-            PC += (signed char)OPERAND2 + 3;
-        }
-        else
-        {
-            PC += 3;
-        }
+        PC += 3;
     }
     return 1;
 }
@@ -377,7 +487,7 @@ static uint8_t add_a_mem(struct em8051 *aCPU)
     return 0;
 }
 
-static uint8_t add_a_indir_rx(struct em8051 *aCPU)
+FORCE_INLINE uint8_t add_a_indir_rx(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t address = INDIR_RX_ADDRESS;
     uint8_t value = read_mem_indir(aCPU, address);
@@ -389,41 +499,13 @@ static uint8_t add_a_indir_rx(struct em8051 *aCPU)
 
 static uint8_t jnb_bitaddr_offset(struct em8051 *aCPU)
 {
-    uint8_t address = OPERAND1;
-    if (address > 0x7f)
+    if (!read_bit(aCPU, OPERAND1))
     {
-        uint8_t bitaddr = address & 7;
-        uint8_t bitmask = (1 << bitaddr);
-        uint8_t value;
-        address &= 0xf8;        
-        if (aCPU->sfrread[address - 0x80])
-            value = aCPU->sfrread[address - 0x80](aCPU, address);
-        else
-            value = aCPU->mSFR[address - 0x80];
-        
-        if (!(value & bitmask))
-        {
-            PC += (signed char)OPERAND2 + 3;
-        }
-        else
-        {
-            PC += 3;
-        }
+        PC += (signed char)OPERAND2 + 3;
     }
     else
     {
-        uint8_t bitaddr = address & 7;
-        uint8_t bitmask = (1 << bitaddr);
-        address >>= 3;
-        address += 0x20;
-        if (!(aCPU->mLowerData[address] & bitmask))
-        {
-            PC += (signed char)OPERAND2 + 3;
-        }
-        else
-        {
-            PC += 3;
-        }
+        PC += 3;
     }
     return 1;
 }
@@ -438,12 +520,12 @@ static uint8_t reti(struct em8051 *aCPU)
             if (aCPU->mInterruptActive > 1)
                 hi = 1;
             if (aCPU->int_a[hi] != aCPU->mSFR[REG_ACC])
-                aCPU->except(aCPU, EXCEPTION_IRET_ACC_MISMATCH);
+                exception(aCPU, EXCEPTION_IRET_ACC_MISMATCH);
             if (aCPU->int_sp[hi] != aCPU->mSFR[REG_SP])
-                aCPU->except(aCPU, EXCEPTION_IRET_SP_MISMATCH);    
+                exception(aCPU, EXCEPTION_IRET_SP_MISMATCH);    
             if ((aCPU->int_psw[hi] & (PSWMASK_OV | PSWMASK_RS0 | PSWMASK_RS1 | PSWMASK_AC | PSWMASK_C)) !=                 
-                (aCPU->mSFR[REG_PSW] & (PSWMASK_OV | PSWMASK_RS0 | PSWMASK_RS1 | PSWMASK_AC | PSWMASK_C)))
-                aCPU->except(aCPU, EXCEPTION_IRET_PSW_MISMATCH);
+                (PSW & (PSWMASK_OV | PSWMASK_RS0 | PSWMASK_RS1 | PSWMASK_AC | PSWMASK_C)))
+                exception(aCPU, EXCEPTION_IRET_PSW_MISMATCH);
         }
 
         if (aCPU->mInterruptActive & 2)
@@ -486,7 +568,7 @@ static uint8_t addc_a_mem(struct em8051 *aCPU)
     return 0;
 }
 
-static uint8_t addc_a_indir_rx(struct em8051 *aCPU)
+FORCE_INLINE uint8_t addc_a_indir_rx(struct em8051 *aCPU, uint8_t aRx)
 {
     bool carry = CARRY;
     uint8_t address = INDIR_RX_ADDRESS;
@@ -544,7 +626,7 @@ static uint8_t orl_a_mem(struct em8051 *aCPU)
     return 0;
 }
 
-static uint8_t orl_a_indir_rx(struct em8051 *aCPU)
+FORCE_INLINE uint8_t orl_a_indir_rx(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t address = INDIR_RX_ADDRESS;
     uint8_t value = read_mem_indir(aCPU, address);
@@ -573,7 +655,9 @@ static uint8_t anl_mem_a(struct em8051 *aCPU)
     uint8_t address = OPERAND1;
     if (address > 0x7f)
     {
+        sync_sfr(aCPU, address);
         aCPU->mSFR[address - 0x80] &= ACC;
+        sfr_written(aCPU, address);
         if (aCPU->sfrwrite[address - 0x80])
             aCPU->sfrwrite[address - 0x80](aCPU, address);
     }
@@ -609,7 +693,7 @@ static uint8_t anl_a_mem(struct em8051 *aCPU)
     return 0;
 }
 
-static uint8_t anl_a_indir_rx(struct em8051 *aCPU)
+FORCE_INLINE uint8_t anl_a_indir_rx(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t address = INDIR_RX_ADDRESS;
     uint8_t value = read_mem_indir(aCPU, address);
@@ -637,7 +721,9 @@ static uint8_t xrl_mem_a(struct em8051 *aCPU)
     uint8_t address = OPERAND1;
     if (address > 0x7f)
     {
+        sync_sfr(aCPU, address);
         aCPU->mSFR[address - 0x80] ^= ACC;
+        sfr_written(aCPU, address);
         if (aCPU->sfrwrite[address - 0x80])
             aCPU->sfrwrite[address - 0x80](aCPU, address);
     }
@@ -673,7 +759,7 @@ static uint8_t xrl_a_mem(struct em8051 *aCPU)
     return 0;
 }
 
-static uint8_t xrl_a_indir_rx(struct em8051 *aCPU)
+FORCE_INLINE uint8_t xrl_a_indir_rx(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t address = INDIR_RX_ADDRESS;
     uint8_t value = read_mem_indir(aCPU, address);
@@ -698,33 +784,10 @@ static uint8_t jnz_offset(struct em8051 *aCPU)
 
 static uint8_t orl_c_bitaddr(struct em8051 *aCPU)
 {
-    uint8_t address = OPERAND1;
     bool carry = CARRY;
-    if (address > 0x7f)
-    {
-        uint8_t bitaddr = address & 7;
-        uint8_t bitmask = (1 << bitaddr);
-        uint8_t value;
-        address &= 0xf8;        
-        if (aCPU->sfrread[address - 0x80])
-            value = aCPU->sfrread[address - 0x80](aCPU, address);
-        else
-            value = aCPU->mSFR[address - 0x80];
-
-        value = (value & bitmask) ? 1 : carry;
-
-        PSW = (PSW & ~PSWMASK_C) | (PSWMASK_C * value);
-    }
-    else
-    {
-        uint8_t bitaddr = address & 7;
-        uint8_t bitmask = (1 << bitaddr);
-        uint8_t value;
-        address >>= 3;
-        address += 0x20;
-        value = (aCPU->mLowerData[address] & bitmask) ? 1 : carry;
-        PSW = (PSW & ~PSWMASK_C) | (PSWMASK_C * value);
-    }
+    bool value = read_bit(aCPU, OPERAND1);
+    value = value ? 1 : carry;
+    PSW = (PSW & ~PSWMASK_C) | (PSWMASK_C * value);
     PC += 2;
     return 1;
 }
@@ -750,7 +813,7 @@ static uint8_t mov_mem_imm(struct em8051 *aCPU)
     return 1;
 }
 
-static uint8_t mov_indir_rx_imm(struct em8051 *aCPU)
+FORCE_INLINE uint8_t mov_indir_rx_imm(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t address = INDIR_RX_ADDRESS;
     uint8_t value = OPERAND1;
@@ -769,33 +832,10 @@ static uint8_t sjmp_offset(struct em8051 *aCPU)
 
 static uint8_t anl_c_bitaddr(struct em8051 *aCPU)
 {
-    uint8_t address = OPERAND1;
     bool carry = CARRY;
-    if (address > 0x7f)
-    {
-        uint8_t bitaddr = address & 7;
-        uint8_t bitmask = (1 << bitaddr);
-        uint8_t value;
-        address &= 0xf8;        
-        if (aCPU->sfrread[address - 0x80])
-            value = aCPU->sfrread[address - 0x80](aCPU, address);
-        else
-            value = aCPU->mSFR[address - 0x80];
-
-        value = (value & bitmask) ? carry : 0;
-
-        PSW = (PSW & ~PSWMASK_C) | (PSWMASK_C * value);
-    }
-    else
-    {
-        uint8_t bitaddr = address & 7;
-        uint8_t bitmask = (1 << bitaddr);
-        uint8_t value;
-        address >>= 3;
-        address += 0x20;
-        value = (aCPU->mLowerData[address] & bitmask) ? carry : 0;
-        PSW = (PSW & ~PSWMASK_C) | (PSWMASK_C * value);
-    }
+    bool value = read_bit(aCPU, OPERAND1);
+    value = value ? carry : 0;
+    PSW = (PSW & ~PSWMASK_C) | (PSWMASK_C * value);
     PC += 2;
     return 0;
 }
@@ -840,7 +880,7 @@ static uint8_t mov_mem_mem(struct em8051 *aCPU)
     return 1;
 }
 
-static uint8_t mov_mem_indir_rx(struct em8051 *aCPU)
+FORCE_INLINE uint8_t mov_mem_indir_rx(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t address_from = OPERAND1;
     uint8_t address_to = INDIR_RX_ADDRESS;
@@ -861,28 +901,7 @@ static uint8_t mov_dptr_imm(struct em8051 *aCPU)
 
 static uint8_t mov_bitaddr_c(struct em8051 *aCPU)
 {
-    uint8_t address = OPERAND1;
-    bool carry = CARRY;
-    if (address > 0x7f)
-    {
-        // Note: when this instruction is used to test an output pin, the value used
-        // as the original data will be read from the output data latch, not the input pin
-        // -- MCS(r) 51 Microcontroller Family User's Manual
-        uint8_t bitaddr = address & 7;
-        uint8_t bitmask = (1 << bitaddr);
-        address &= 0xf8;        
-        aCPU->mSFR[address - 0x80] = (aCPU->mSFR[address - 0x80] & ~bitmask) | (carry << bitaddr);
-        if (aCPU->sfrwrite[address - 0x80])
-            aCPU->sfrwrite[address - 0x80](aCPU, address);
-    }
-    else
-    {
-        uint8_t bitaddr = address & 7;
-        uint8_t bitmask = (1 << bitaddr);
-        address >>= 3;
-        address += 0x20;
-        aCPU->mLowerData[address] = (aCPU->mLowerData[address] & ~bitmask) | (carry << bitaddr);
-    }
+    modify_bit(aCPU, OPERAND1, true, CARRY);
     PC += 2;
     return 1;
 }
@@ -914,7 +933,7 @@ static uint8_t subb_a_mem(struct em8051 *aCPU)
     PC += 2;
     return 0;
 }
-static uint8_t subb_a_indir_rx(struct em8051 *aCPU)
+FORCE_INLINE uint8_t subb_a_indir_rx(struct em8051 *aCPU, uint8_t aRx)
 {
     bool carry = CARRY;
     uint8_t address = INDIR_RX_ADDRESS;
@@ -928,66 +947,18 @@ static uint8_t subb_a_indir_rx(struct em8051 *aCPU)
 
 static uint8_t orl_c_compl_bitaddr(struct em8051 *aCPU)
 {
-    uint8_t address = OPERAND1;
     bool carry = CARRY;
-    if (address > 0x7f)
-    {
-        uint8_t bitaddr = address & 7;
-        uint8_t bitmask = (1 << bitaddr);
-        uint8_t value;
-        address &= 0xf8;        
-        if (aCPU->sfrread[address - 0x80])
-            value = aCPU->sfrread[address - 0x80](aCPU, address);
-        else
-            value = aCPU->mSFR[address - 0x80];
-
-        value = (value & bitmask) ? carry : 1;
-
-        PSW = (PSW & ~PSWMASK_C) | (PSWMASK_C * value);
-    }
-    else
-    {
-        uint8_t bitaddr = address & 7;
-        uint8_t bitmask = (1 << bitaddr);
-        uint8_t value;
-        address >>= 3;
-        address += 0x20;
-        value = (aCPU->mLowerData[address] & bitmask) ? carry : 1;
-        PSW = (PSW & ~PSWMASK_C) | (PSWMASK_C * value);
-    }
+    bool value = read_bit(aCPU, OPERAND1);
+    value = value ? carry : 1;
+    PSW = (PSW & ~PSWMASK_C) | (PSWMASK_C * value);
     PC += 2;
     return 0;
 }
 
 static uint8_t mov_c_bitaddr(struct em8051 *aCPU)
 {
-    uint8_t address = OPERAND1;
-    if (address > 0x7f)
-    {
-        uint8_t bitaddr = address & 7;
-        uint8_t bitmask = (1 << bitaddr);
-        uint8_t value;
-        address &= 0xf8;        
-        if (aCPU->sfrread[address - 0x80])
-            value = aCPU->sfrread[address - 0x80](aCPU, address);
-        else
-            value = aCPU->mSFR[address - 0x80];
-
-        value = (value & bitmask) ? 1 : 0;
-
-        PSW = (PSW & ~PSWMASK_C) | (PSWMASK_C * value);
-    }
-    else
-    {
-        uint8_t bitaddr = address & 7;
-        uint8_t bitmask = (1 << bitaddr);
-        uint8_t value;
-        address >>= 3;
-        address += 0x20;
-        value = (aCPU->mLowerData[address] & bitmask) ? 1 : 0;
-        PSW = (PSW & ~PSWMASK_C) | (PSWMASK_C * value);
-    }
-
+    bool value = read_bit(aCPU, OPERAND1);
+    PSW = (PSW & ~PSWMASK_C) | (PSWMASK_C * value);
     PC += 2;
     return 0;
 }
@@ -1015,7 +986,7 @@ static uint8_t mul_ab(struct em8051 *aCPU)
     return 3;
 }
 
-static uint8_t mov_indir_rx_mem(struct em8051 *aCPU)
+FORCE_INLINE uint8_t mov_indir_rx_mem(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t address_to = INDIR_RX_ADDRESS;
     uint8_t address_from = OPERAND1;
@@ -1028,33 +999,10 @@ static uint8_t mov_indir_rx_mem(struct em8051 *aCPU)
 
 static uint8_t anl_c_compl_bitaddr(struct em8051 *aCPU)
 {
-    uint8_t address = OPERAND1;
     bool carry = CARRY;
-    if (address > 0x7f)
-    {
-        uint8_t bitaddr = address & 7;
-        uint8_t bitmask = (1 << bitaddr);
-        uint8_t value;
-        address &= 0xf8;        
-        if (aCPU->sfrread[address - 0x80])
-            value = aCPU->sfrread[address - 0x80](aCPU, address);
-        else
-            value = aCPU->mSFR[address - 0x80];
-
-        value = (value & bitmask) ? 0 : carry;
-
-        PSW = (PSW & ~PSWMASK_C) | (PSWMASK_C * value);
-    }
-    else
-    {
-        uint8_t bitaddr = address & 7;
-        uint8_t bitmask = (1 << bitaddr);
-        uint8_t value;
-        address >>= 3;
-        address += 0x20;
-        value = (aCPU->mLowerData[address] & bitmask) ? 0 : carry;
-        PSW = (PSW & ~PSWMASK_C) | (PSWMASK_C * value);
-    }
+    bool value = read_bit(aCPU, OPERAND1);
+    value = value ? 0 : carry;
+    PSW = (PSW & ~PSWMASK_C) | (PSWMASK_C * value);
     PC += 2;
     return 0;
 }
@@ -1062,27 +1010,7 @@ static uint8_t anl_c_compl_bitaddr(struct em8051 *aCPU)
 
 static uint8_t cpl_bitaddr(struct em8051 *aCPU)
 {
-    uint8_t address = OPERAND1;
-    if (address > 0x7f)
-    {
-        // Note: when this instruction is used to test an output pin, the value used
-        // as the original data will be read from the output data latch, not the input pin
-        // -- MCS(r) 51 Microcontroller Family User's Manual
-        uint8_t bitaddr = address & 7;
-        uint8_t bitmask = (1 << bitaddr);
-        address &= 0xf8;        
-        aCPU->mSFR[address - 0x80] ^= bitmask;
-        if (aCPU->sfrwrite[address - 0x80])
-            aCPU->sfrwrite[address - 0x80](aCPU, address);
-    }
-    else
-    {
-        uint8_t bitaddr = address & 7;
-        uint8_t bitmask = (1 << bitaddr);
-        address >>= 3;
-        address += 0x20;
-        aCPU->mLowerData[address] ^= bitmask;
-    }
+    modify_bit(aCPU, OPERAND1, false, true);
     PC += 2;
     return 0;
 }
@@ -1142,7 +1070,7 @@ static uint8_t cjne_a_mem_offset(struct em8051 *aCPU)
     }
     return 1;
 }
-static uint8_t cjne_indir_rx_imm_offset(struct em8051 *aCPU)
+FORCE_INLINE uint8_t cjne_indir_rx_imm_offset(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t address = INDIR_RX_ADDRESS;
     uint8_t value1 = read_mem_indir(aCPU, address);
@@ -1179,27 +1107,7 @@ static uint8_t push_mem(struct em8051 *aCPU)
 
 static uint8_t clr_bitaddr(struct em8051 *aCPU)
 {
-    uint8_t address = OPERAND1;
-    if (address > 0x7f)
-    {
-        // Note: when this instruction is used to test an output pin, the value used
-        // as the original data will be read from the output data latch, not the input pin
-        // -- MCS(r) 51 Microcontroller Family User's Manual
-        uint8_t bitaddr = address & 7;
-        uint8_t bitmask = (1 << bitaddr);
-        address &= 0xf8;        
-        aCPU->mSFR[address - 0x80] &= ~bitmask;
-        if (aCPU->sfrwrite[address - 0x80])
-            aCPU->sfrwrite[address - 0x80](aCPU, address);
-    }
-    else
-    {
-        uint8_t bitaddr = address & 7;
-        uint8_t bitmask = (1 << bitaddr);
-        address >>= 3;
-        address += 0x20;
-        aCPU->mLowerData[address] &= ~bitmask;
-    }
+    modify_bit(aCPU, OPERAND1, true, false);
     PC += 2;
     return 0;
 }
@@ -1228,7 +1136,7 @@ static uint8_t xch_a_mem(struct em8051 *aCPU)
     return 0;
 }
 
-static uint8_t xch_a_indir_rx(struct em8051 *aCPU)
+FORCE_INLINE uint8_t xch_a_indir_rx(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t address = INDIR_RX_ADDRESS;
     uint8_t value = read_mem_indir(aCPU, address);
@@ -1250,27 +1158,7 @@ static uint8_t pop_mem(struct em8051 *aCPU)
 
 static uint8_t setb_bitaddr(struct em8051 *aCPU)
 {
-    uint8_t address = OPERAND1;
-    if (address > 0x7f)
-    {
-        // Note: when this instruction is used to test an output pin, the value used
-        // as the original data will be read from the output data latch, not the input pin
-        // -- MCS(r) 51 Microcontroller Family User's Manual
-        uint8_t bitaddr = address & 7;
-        uint8_t bitmask = (1 << bitaddr);
-        address &= 0xf8;        
-        aCPU->mSFR[address - 0x80] |= bitmask;
-        if (aCPU->sfrwrite[address - 0x80])
-            aCPU->sfrwrite[address - 0x80](aCPU, address);
-    }
-    else
-    {
-        uint8_t bitaddr = address & 7;
-        uint8_t bitmask = (1 << bitaddr);
-        address >>= 3;
-        address += 0x20;
-        aCPU->mLowerData[address] |= bitmask;
-    }
+    modify_bit(aCPU, OPERAND1, true, true);
     PC += 2;
     return 0;
 }
@@ -1331,7 +1219,7 @@ static uint8_t djnz_mem_offset(struct em8051 *aCPU)
     return 1;
 }
 
-static uint8_t xchd_a_indir_rx(struct em8051 *aCPU)
+FORCE_INLINE uint8_t xchd_a_indir_rx(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t address = INDIR_RX_ADDRESS;
     uint8_t value = read_mem_indir(aCPU, address);
@@ -1345,9 +1233,13 @@ static uint8_t xchd_a_indir_rx(struct em8051 *aCPU)
 static uint8_t movx_a_indir_dptr(struct em8051 *aCPU)
 {
     uint16_t dptr = DPTR;
-    if (aCPU->xread)
+    if (aCPU->xreadpage[dptr >> 8])
     {
-        ACC = aCPU->xread(aCPU, dptr);
+        ACC = xdata_callback(aCPU, aCPU->xreadpage[dptr >> 8], dptr);
+    }
+    else if (aCPU->xread)
+    {
+        ACC = xdata_callback(aCPU, aCPU->xread, dptr);
     }
     else
     {
@@ -1358,12 +1250,16 @@ static uint8_t movx_a_indir_dptr(struct em8051 *aCPU)
     return 1;
 }
 
-static uint8_t movx_a_indir_rx(struct em8051 *aCPU)
+FORCE_INLINE uint8_t movx_a_indir_rx(struct em8051 *aCPU, uint8_t aRx)
 {
     uint16_t address = INDIR_RX_ADDRESS;
-    if (aCPU->xread)
+    if (aCPU->xreadpage[address >> 8])
     {
-        ACC = aCPU->xread(aCPU, address);
+        ACC = xdata_callback(aCPU, aCPU->xreadpage[address >> 8], address);
+    }
+    else if (aCPU->xread)
+    {
+        ACC = xdata_callback(aCPU, aCPU->xread, address);
     }
     else
     {
@@ -1389,14 +1285,14 @@ static uint8_t mov_a_mem(struct em8051 *aCPU)
     uint8_t value = read_mem(aCPU, address);
     if (REG_ACC == address - 0x80)
         if (aCPU->except)
-            aCPU->except(aCPU, EXCEPTION_ACC_TO_A);
+            exception(aCPU, EXCEPTION_ACC_TO_A);
     ACC = value;
 
     PC += 2;
     return 0;
 }
 
-static uint8_t mov_a_indir_rx(struct em8051 *aCPU)
+FORCE_INLINE uint8_t mov_a_indir_rx(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t address = INDIR_RX_ADDRESS;
     ACC = read_mem_indir(aCPU, address);
@@ -1408,7 +1304,11 @@ static uint8_t mov_a_indir_rx(struct em8051 *aCPU)
 static uint8_t movx_indir_dptr_a(struct em8051 *aCPU)
 {
     uint16_t dptr = DPTR;
-    if (aCPU->xwrite)
+    if (aCPU->xwritepage[dptr >> 8])
+    {
+        aCPU->xwritepage[dptr >> 8](aCPU, dptr, ACC);
+    }
+    else if (aCPU->xwrite)
     {
         aCPU->xwrite(aCPU, dptr, ACC);
     }
@@ -1417,16 +1317,24 @@ static uint8_t movx_indir_dptr_a(struct em8051 *aCPU)
         if (aCPU->mExtData)
             EXTDATA(dptr) = ACC;
     }
+    aCPU->mXDirty[(dptr & XDATA_MASK) >> 8] = 1;
+    // external memory may be aliased over code memory
+    if (aCPU->mDecoded && aCPU->mExtData == aCPU->mCodeMem)
+        invalidate_code(aCPU, dptr & XDATA_MASK, 1);
 
     PC++;
     return 1;
 }
 
-static uint8_t movx_indir_rx_a(struct em8051 *aCPU)
+FORCE_INLINE uint8_t movx_indir_rx_a(struct em8051 *aCPU, uint8_t aRx)
 {
     uint16_t address = INDIR_RX_ADDRESS;
 
-    if (aCPU->xwrite)
+    if (aCPU->xwritepage[address >> 8])
+    {
+        aCPU->xwritepage[address >> 8](aCPU, address, ACC);
+    }
+    else if (aCPU->xwrite)
     {
         aCPU->xwrite(aCPU, address, ACC);
     }
@@ -1435,6 +1343,10 @@ static uint8_t movx_indir_rx_a(struct em8051 *aCPU)
         if (aCPU->mExtData)
             EXTDATA(address) = ACC;
     }
+    aCPU->mXDirty[(address & XDATA_MASK) >> 8] = 1;
+    // external memory may be aliased over code memory
+    if (aCPU->mDecoded && aCPU->mExtData == aCPU->mCodeMem)
+        invalidate_code(aCPU, address & XDATA_MASK, 1);
 
     PC++;
     return 1;
@@ -1455,7 +1367,7 @@ static uint8_t mov_mem_a(struct em8051 *aCPU)
     return 0;
 }
 
-static uint8_t mov_indir_rx_a(struct em8051 *aCPU)
+FORCE_INLINE uint8_t mov_indir_rx_a(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t address = INDIR_RX_ADDRESS;
     write_mem_indir(aCPU, address, ACC);
@@ -1467,12 +1379,12 @@ static uint8_t nop(struct em8051 *aCPU)
 {
     if (CODEMEM(PC) != 0)
         if (aCPU->except)
-            aCPU->except(aCPU, EXCEPTION_ILLEGAL_OPCODE);
+            exception(aCPU, EXCEPTION_ILLEGAL_OPCODE);
     PC++;
     return 0;
 }
 
-static uint8_t inc_rx(struct em8051 *aCPU)
+FORCE_INLINE uint8_t inc_rx(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t rx = RX_ADDRESS;
     aCPU->mLowerData[rx]++;
@@ -1480,7 +1392,7 @@ static uint8_t inc_rx(struct em8051 *aCPU)
     return 0;
 }
 
-static uint8_t dec_rx(struct em8051 *aCPU)
+FORCE_INLINE uint8_t dec_rx(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t rx = RX_ADDRESS;
     aCPU->mLowerData[rx]--;
@@ -1488,7 +1400,7 @@ static uint8_t dec_rx(struct em8051 *aCPU)
     return 0;
 }
 
-static uint8_t add_a_rx(struct em8051 *aCPU)
+FORCE_INLINE uint8_t add_a_rx(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t rx = RX_ADDRESS;
     add_solve_flags(aCPU, aCPU->mLowerData[rx], ACC, 0);
@@ -1497,7 +1409,7 @@ static uint8_t add_a_rx(struct em8051 *aCPU)
     return 0;
 }
 
-static uint8_t addc_a_rx(struct em8051 *aCPU)
+FORCE_INLINE uint8_t addc_a_rx(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t rx = RX_ADDRESS;
     bool carry = CARRY;
@@ -1507,7 +1419,7 @@ static uint8_t addc_a_rx(struct em8051 *aCPU)
     return 0;
 }
 
-static uint8_t orl_a_rx(struct em8051 *aCPU)
+FORCE_INLINE uint8_t orl_a_rx(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t rx = RX_ADDRESS;
     ACC |= aCPU->mLowerData[rx];
@@ -1515,7 +1427,7 @@ static uint8_t orl_a_rx(struct em8051 *aCPU)
     return 0;
 }
 
-static uint8_t anl_a_rx(struct em8051 *aCPU)
+FORCE_INLINE uint8_t anl_a_rx(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t rx = RX_ADDRESS;
     ACC &= aCPU->mLowerData[rx];
@@ -1523,7 +1435,7 @@ static uint8_t anl_a_rx(struct em8051 *aCPU)
     return 0;
 }
 
-static uint8_t xrl_a_rx(struct em8051 *aCPU)
+FORCE_INLINE uint8_t xrl_a_rx(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t rx = RX_ADDRESS;
     ACC ^= aCPU->mLowerData[rx];    
@@ -1532,7 +1444,7 @@ static uint8_t xrl_a_rx(struct em8051 *aCPU)
 }
 
 
-static uint8_t mov_rx_imm(struct em8051 *aCPU)
+FORCE_INLINE uint8_t mov_rx_imm(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t rx = RX_ADDRESS;
     aCPU->mLowerData[rx] = OPERAND1;
@@ -1540,7 +1452,7 @@ static uint8_t mov_rx_imm(struct em8051 *aCPU)
     return 0;
 }
 
-static uint8_t mov_mem_rx(struct em8051 *aCPU)
+FORCE_INLINE uint8_t mov_mem_rx(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t rx = RX_ADDRESS;
     uint8_t address = OPERAND1;
@@ -1549,7 +1461,7 @@ static uint8_t mov_mem_rx(struct em8051 *aCPU)
     return 1;
 }
 
-static uint8_t subb_a_rx(struct em8051 *aCPU)
+FORCE_INLINE uint8_t subb_a_rx(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t rx = RX_ADDRESS;
     bool carry = CARRY;
@@ -1559,7 +1471,7 @@ static uint8_t subb_a_rx(struct em8051 *aCPU)
     return 0;
 }
 
-static uint8_t mov_rx_mem(struct em8051 *aCPU)
+FORCE_INLINE uint8_t mov_rx_mem(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t rx = RX_ADDRESS;
     uint8_t value = read_mem(aCPU, OPERAND1);
@@ -1569,7 +1481,7 @@ static uint8_t mov_rx_mem(struct em8051 *aCPU)
     return 1;
 }
 
-static uint8_t cjne_rx_imm_offset(struct em8051 *aCPU)
+FORCE_INLINE uint8_t cjne_rx_imm_offset(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t rx = RX_ADDRESS;
     uint8_t value = OPERAND1;
@@ -1594,7 +1506,7 @@ static uint8_t cjne_rx_imm_offset(struct em8051 *aCPU)
     return 1;
 }
 
-static uint8_t xch_a_rx(struct em8051 *aCPU)
+FORCE_INLINE uint8_t xch_a_rx(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t rx = RX_ADDRESS;
     uint8_t a = ACC;
@@ -1604,7 +1516,7 @@ static uint8_t xch_a_rx(struct em8051 *aCPU)
     return 0;
 }
 
-static uint8_t djnz_rx_offset(struct em8051 *aCPU)
+FORCE_INLINE uint8_t djnz_rx_offset(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t rx = RX_ADDRESS;
     aCPU->mLowerData[rx]--;
@@ -1619,7 +1531,7 @@ static uint8_t djnz_rx_offset(struct em8051 *aCPU)
     return 1;
 }
 
-static uint8_t mov_a_rx(struct em8051 *aCPU)
+FORCE_INLINE uint8_t mov_a_rx(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t rx = RX_ADDRESS;
     ACC = aCPU->mLowerData[rx];
@@ -1628,7 +1540,7 @@ static uint8_t mov_a_rx(struct em8051 *aCPU)
     return 0;
 }
 
-static uint8_t mov_rx_a(struct em8051 *aCPU)
+FORCE_INLINE uint8_t mov_rx_a(struct em8051 *aCPU, uint8_t aRx)
 {
     uint8_t rx = RX_ADDRESS;
     aCPU->mLowerData[rx] = ACC;
@@ -1636,174 +1548,406 @@ static uint8_t mov_rx_a(struct em8051 *aCPU)
     return 0;
 }
 
-void op_setptrs(struct em8051 *aCPU)
-{
-    uint8_t i;
-    for (i = 0; i < 8; i++)
-    {
-        aCPU->op[0x08 + i] = &inc_rx;
-        aCPU->op[0x18 + i] = &dec_rx;
-        aCPU->op[0x28 + i] = &add_a_rx;
-        aCPU->op[0x38 + i] = &addc_a_rx;
-        aCPU->op[0x48 + i] = &orl_a_rx;
-        aCPU->op[0x58 + i] = &anl_a_rx;
-        aCPU->op[0x68 + i] = &xrl_a_rx;
-        aCPU->op[0x78 + i] = &mov_rx_imm;
-        aCPU->op[0x88 + i] = &mov_mem_rx;
-        aCPU->op[0x98 + i] = &subb_a_rx;
-        aCPU->op[0xa8 + i] = &mov_rx_mem;
-        aCPU->op[0xb8 + i] = &cjne_rx_imm_offset;
-        aCPU->op[0xc8 + i] = &xch_a_rx;
-        aCPU->op[0xd8 + i] = &djnz_rx_offset;
-        aCPU->op[0xe8 + i] = &mov_a_rx;
-        aCPU->op[0xf8 + i] = &mov_rx_a;
-    }
-    aCPU->op[0x00] = &nop;
-    aCPU->op[0x01] = &ajmp_offset;
-    aCPU->op[0x02] = &ljmp_address;
-    aCPU->op[0x03] = &rr_a;
-    aCPU->op[0x04] = &inc_a;
-    aCPU->op[0x05] = &inc_mem;
-    aCPU->op[0x06] = &inc_indir_rx;
-    aCPU->op[0x07] = &inc_indir_rx;
-
-    aCPU->op[0x10] = &jbc_bitaddr_offset;
-    aCPU->op[0x11] = &acall_offset;
-    aCPU->op[0x12] = &lcall_address;
-    aCPU->op[0x13] = &rrc_a;
-    aCPU->op[0x14] = &dec_a;
-    aCPU->op[0x15] = &dec_mem;
-    aCPU->op[0x16] = &dec_indir_rx;
-    aCPU->op[0x17] = &dec_indir_rx;
-
-    aCPU->op[0x20] = &jb_bitaddr_offset;
-    aCPU->op[0x21] = &ajmp_offset;
-    aCPU->op[0x22] = &ret;
-    aCPU->op[0x23] = &rl_a;
-    aCPU->op[0x24] = &add_a_imm;
-    aCPU->op[0x25] = &add_a_mem;
-    aCPU->op[0x26] = &add_a_indir_rx;
-    aCPU->op[0x27] = &add_a_indir_rx;
-
-    aCPU->op[0x30] = &jnb_bitaddr_offset;
-    aCPU->op[0x31] = &acall_offset;
-    aCPU->op[0x32] = &reti;
-    aCPU->op[0x33] = &rlc_a;
-    aCPU->op[0x34] = &addc_a_imm;
-    aCPU->op[0x35] = &addc_a_mem;
-    aCPU->op[0x36] = &addc_a_indir_rx;
-    aCPU->op[0x37] = &addc_a_indir_rx;
-
-    aCPU->op[0x40] = &jc_offset;
-    aCPU->op[0x41] = &ajmp_offset;
-    aCPU->op[0x42] = &orl_mem_a;
-    aCPU->op[0x43] = &orl_mem_imm;
-    aCPU->op[0x44] = &orl_a_imm;
-    aCPU->op[0x45] = &orl_a_mem;
-    aCPU->op[0x46] = &orl_a_indir_rx;
-    aCPU->op[0x47] = &orl_a_indir_rx;
-
-    aCPU->op[0x50] = &jnc_offset;
-    aCPU->op[0x51] = &acall_offset;
-    aCPU->op[0x52] = &anl_mem_a;
-    aCPU->op[0x53] = &anl_mem_imm;
-    aCPU->op[0x54] = &anl_a_imm;
-    aCPU->op[0x55] = &anl_a_mem;
-    aCPU->op[0x56] = &anl_a_indir_rx;
-    aCPU->op[0x57] = &anl_a_indir_rx;
-
-    aCPU->op[0x60] = &jz_offset;
-    aCPU->op[0x61] = &ajmp_offset;
-    aCPU->op[0x62] = &xrl_mem_a;
-    aCPU->op[0x63] = &xrl_mem_imm;
-    aCPU->op[0x64] = &xrl_a_imm;
-    aCPU->op[0x65] = &xrl_a_mem;
-    aCPU->op[0x66] = &xrl_a_indir_rx;
-    aCPU->op[0x67] = &xrl_a_indir_rx;
-
-    aCPU->op[0x70] = &jnz_offset;
-    aCPU->op[0x71] = &acall_offset;
-    aCPU->op[0x72] = &orl_c_bitaddr;
-    aCPU->op[0x73] = &jmp_indir_a_dptr;
-    aCPU->op[0x74] = &mov_a_imm;
-    aCPU->op[0x75] = &mov_mem_imm;
-    aCPU->op[0x76] = &mov_indir_rx_imm;
-    aCPU->op[0x77] = &mov_indir_rx_imm;
-
-    aCPU->op[0x80] = &sjmp_offset;
-    aCPU->op[0x81] = &ajmp_offset;
-    aCPU->op[0x82] = &anl_c_bitaddr;
-    aCPU->op[0x83] = &movc_a_indir_a_pc;
-    aCPU->op[0x84] = &div_ab;
-    aCPU->op[0x85] = &mov_mem_mem;
-    aCPU->op[0x86] = &mov_mem_indir_rx;
-    aCPU->op[0x87] = &mov_mem_indir_rx;
-
-    aCPU->op[0x90] = &mov_dptr_imm;
-    aCPU->op[0x91] = &acall_offset;
-    aCPU->op[0x92] = &mov_bitaddr_c;
-    aCPU->op[0x93] = &movc_a_indir_a_dptr;
-    aCPU->op[0x94] = &subb_a_imm;
-    aCPU->op[0x95] = &subb_a_mem;
-    aCPU->op[0x96] = &subb_a_indir_rx;
-    aCPU->op[0x97] = &subb_a_indir_rx;
-
-    aCPU->op[0xa0] = &orl_c_compl_bitaddr;
-    aCPU->op[0xa1] = &ajmp_offset;
-    aCPU->op[0xa2] = &mov_c_bitaddr;
-    aCPU->op[0xa3] = &inc_dptr;
-    aCPU->op[0xa4] = &mul_ab;
-    aCPU->op[0xa5] = &nop; // unused
-    aCPU->op[0xa6] = &mov_indir_rx_mem;
-    aCPU->op[0xa7] = &mov_indir_rx_mem;
-
-    aCPU->op[0xb0] = &anl_c_compl_bitaddr;
-    aCPU->op[0xb1] = &acall_offset;
-    aCPU->op[0xb2] = &cpl_bitaddr;
-    aCPU->op[0xb3] = &cpl_c;
-    aCPU->op[0xb4] = &cjne_a_imm_offset;
-    aCPU->op[0xb5] = &cjne_a_mem_offset;
-    aCPU->op[0xb6] = &cjne_indir_rx_imm_offset;
-    aCPU->op[0xb7] = &cjne_indir_rx_imm_offset;
-
-    aCPU->op[0xc0] = &push_mem;
-    aCPU->op[0xc1] = &ajmp_offset;
-    aCPU->op[0xc2] = &clr_bitaddr;
-    aCPU->op[0xc3] = &clr_c;
-    aCPU->op[0xc4] = &swap_a;
-    aCPU->op[0xc5] = &xch_a_mem;
-    aCPU->op[0xc6] = &xch_a_indir_rx;
-    aCPU->op[0xc7] = &xch_a_indir_rx;
-
-    aCPU->op[0xd0] = &pop_mem;
-    aCPU->op[0xd1] = &acall_offset;
-    aCPU->op[0xd2] = &setb_bitaddr;
-    aCPU->op[0xd3] = &setb_c;
-    aCPU->op[0xd4] = &da_a;
-    aCPU->op[0xd5] = &djnz_mem_offset;
-    aCPU->op[0xd6] = &xchd_a_indir_rx;
-    aCPU->op[0xd7] = &xchd_a_indir_rx;
-
-    aCPU->op[0xe0] = &movx_a_indir_dptr;
-    aCPU->op[0xe1] = &ajmp_offset;
-    aCPU->op[0xe2] = &movx_a_indir_rx;
-    aCPU->op[0xe3] = &movx_a_indir_rx;
-    aCPU->op[0xe4] = &clr_a;
-    aCPU->op[0xe5] = &mov_a_mem;
-    aCPU->op[0xe6] = &mov_a_indir_rx;
-    aCPU->op[0xe7] = &mov_a_indir_rx;
-
-    aCPU->op[0xf0] = &movx_indir_dptr_a;
-    aCPU->op[0xf1] = &acall_offset;
-    aCPU->op[0xf2] = &movx_indir_rx_a;
-    aCPU->op[0xf3] = &movx_indir_rx_a;
-    aCPU->op[0xf4] = &cpl_a;
-    aCPU->op[0xf5] = &mov_mem_a;
-    aCPU->op[0xf6] = &mov_indir_rx_a;
-    aCPU->op[0xf7] = &mov_indir_rx_a;
-}
-
-uint8_t do_op(struct em8051 *aCPU)
+// One handler per register for the Rn and @Ri forms
+#define RX_HANDLER(name, rx) \
+    static uint8_t name##rx(struct em8051 *aCPU) { return name(aCPU, rx); }
+#define INDIR_RX_HANDLERS(name) \
+    RX_HANDLER(name, 0) RX_HANDLER(name, 1)
+#define RX_HANDLERS(name) \
+    RX_HANDLER(name, 0) RX_HANDLER(name, 1) RX_HANDLER(name, 2) RX_HANDLER(name, 3) \
+    RX_HANDLER(name, 4) RX_HANDLER(name, 5) RX_HANDLER(name, 6) RX_HANDLER(name, 7)
+
+INDIR_RX_HANDLERS(inc_indir_rx)
+INDIR_RX_HANDLERS(dec_indir_rx)
+INDIR_RX_HANDLERS(add_a_indir_rx)
+INDIR_RX_HANDLERS(addc_a_indir_rx)
+INDIR_RX_HANDLERS(orl_a_indir_rx)
+INDIR_RX_HANDLERS(anl_a_indir_rx)
+INDIR_RX_HANDLERS(xrl_a_indir_rx)
+INDIR_RX_HANDLERS(mov_indir_rx_imm)
+INDIR_RX_HANDLERS(mov_mem_indir_rx)
+INDIR_RX_HANDLERS(subb_a_indir_rx)
+INDIR_RX_HANDLERS(mov_indir_rx_mem)
+INDIR_RX_HANDLERS(cjne_indir_rx_imm_offset)
+INDIR_RX_HANDLERS(xch_a_indir_rx)
+INDIR_RX_HANDLERS(xchd_a_indir_rx)
+INDIR_RX_HANDLERS(movx_a_indir_rx)
+INDIR_RX_HANDLERS(mov_a_indir_rx)
+INDIR_RX_HANDLERS(movx_indir_rx_a)
+INDIR_RX_HANDLERS(mov_indir_rx_a)
+
+RX_HANDLERS(inc_rx)
+RX_HANDLERS(dec_rx)
+RX_HANDLERS(add_a_rx)
+RX_HANDLERS(addc_a_rx)
+RX_HANDLERS(orl_a_rx)
+RX_HANDLERS(anl_a_rx)
+RX_HANDLERS(xrl_a_rx)
+RX_HANDLERS(mov_rx_imm)
+RX_HANDLERS(mov_mem_rx)
+RX_HANDLERS(subb_a_rx)
+RX_HANDLERS(mov_rx_mem)
+RX_HANDLERS(cjne_rx_imm_offset)
+RX_HANDLERS(xch_a_rx)
+RX_HANDLERS(djnz_rx_offset)
+RX_HANDLERS(mov_a_rx)
+RX_HANDLERS(mov_rx_a)
+
+// Operation decoding and block analysis are shared by all variants
+#ifndef EM8051_CORE_VARIANT
+
+// Operation lengths in bytes, by opcode
+static const uint8_t op_length[256] =
+{
+    1, 2, 3, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    3, 2, 3, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    3, 2, 1, 1, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    3, 2, 1, 1, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    2, 2, 2, 3, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    2, 2, 2, 3, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    2, 2, 2, 3, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    2, 2, 2, 1, 2, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    2, 2, 2, 1, 1, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    3, 2, 2, 1, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    2, 2, 2, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    2, 2, 2, 1, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3,
+    2, 2, 2, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    2, 2, 2, 1, 1, 3, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2,
+    1, 2, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 2, 1, 1, 1, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1
+};
+
+// Ticks taken by each operation, by opcode
+static const uint8_t op_ticks[256] =
+{
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1
+};
+
+// What each operation touches, for building blocks
+#define BLK_CF    0x01 // changes PC; ends the block
+#define BLK_RD1   0x02 // reads direct address in operand 1
+#define BLK_WR1   0x04 // writes direct address in operand 1
+#define BLK_WR2   0x08 // writes direct address in operand 2
+#define BLK_BITRD 0x10 // reads bit address in operand 1
+#define BLK_BITWR 0x20 // writes bit address in operand 1
+#define BLK_XREAD 0x40 // reads external memory
+#define BLK_NEVER 0x80 // stack, interrupt return, dynamic SFR writes etc.
+
+static const uint8_t op_block[256] =
+{
+    0, BLK_CF, BLK_CF, 0, 0, BLK_RD1 | BLK_WR1, 0, 0, // 0x00
+    0, 0, 0, 0, 0, 0, 0, 0, // 0x08
+    BLK_BITRD | BLK_BITWR | BLK_CF, BLK_NEVER, BLK_NEVER, 0, 0, BLK_RD1 | BLK_WR1, 0, 0, // 0x10
+    0, 0, 0, 0, 0, 0, 0, 0, // 0x18
+    BLK_BITRD | BLK_CF, BLK_CF, BLK_NEVER, 0, 0, BLK_RD1, 0, 0, // 0x20
+    0, 0, 0, 0, 0, 0, 0, 0, // 0x28
+    BLK_BITRD | BLK_CF, BLK_NEVER, BLK_NEVER, 0, 0, BLK_RD1, 0, 0, // 0x30
+    0, 0, 0, 0, 0, 0, 0, 0, // 0x38
+    BLK_CF, BLK_CF, BLK_RD1 | BLK_WR1, BLK_RD1 | BLK_WR1, 0, BLK_RD1, 0, 0, // 0x40
+    0, 0, 0, 0, 0, 0, 0, 0, // 0x48
+    BLK_CF, BLK_NEVER, BLK_RD1 | BLK_WR1, BLK_RD1 | BLK_WR1, 0, BLK_RD1, 0, 0, // 0x50
+    0, 0, 0, 0, 0, 0, 0, 0, // 0x58
+    BLK_CF, BLK_CF, BLK_RD1 | BLK_WR1, BLK_RD1 | BLK_WR1, 0, BLK_RD1, 0, 0, // 0x60
+    0, 0, 0, 0, 0, 0, 0, 0, // 0x68
+    BLK_CF, BLK_NEVER, BLK_BITRD, BLK_CF, 0, BLK_WR1, 0, 0, // 0x70
+    0, 0, 0, 0, 0, 0, 0, 0, // 0x78
+    BLK_CF, BLK_CF, BLK_BITRD, 0, 0, BLK_RD1 | BLK_WR2, BLK_NEVER, BLK_NEVER, // 0x80
+    BLK_WR1, BLK_WR1, BLK_WR1, BLK_WR1, BLK_WR1, BLK_WR1, BLK_WR1, BLK_WR1, // 0x88
+    0, BLK_NEVER, BLK_BITWR, 0, 0, BLK_RD1, 0, 0, // 0x90
+    0, 0, 0, 0, 0, 0, 0, 0, // 0x98
+    BLK_BITRD, BLK_CF, BLK_BITRD, 0, 0, BLK_NEVER, BLK_RD1, BLK_RD1, // 0xa0
+    BLK_RD1, BLK_RD1, BLK_RD1, BLK_RD1, BLK_RD1, BLK_RD1, BLK_RD1, BLK_RD1, // 0xa8
+    BLK_BITRD, BLK_NEVER, BLK_BITWR, 0, BLK_CF, BLK_RD1 | BLK_CF, BLK_CF, BLK_CF, // 0xb0
+    BLK_CF, BLK_CF, BLK_CF, BLK_CF, BLK_CF, BLK_CF, BLK_CF, BLK_CF, // 0xb8
+    BLK_NEVER, BLK_CF, BLK_BITWR, 0, 0, BLK_RD1 | BLK_WR1, 0, 0, // 0xc0
+    0, 0, 0, 0, 0, 0, 0, 0, // 0xc8
+    BLK_NEVER, BLK_NEVER, BLK_BITWR, 0, 0, BLK_RD1 | BLK_WR1 | BLK_CF, 0, 0, // 0xd0
+    BLK_CF, BLK_CF, BLK_CF, BLK_CF, BLK_CF, BLK_CF, BLK_CF, BLK_CF, // 0xd8
+    BLK_XREAD, BLK_CF, BLK_XREAD, BLK_XREAD, 0, BLK_RD1, 0, 0, // 0xe0
+    0, 0, 0, 0, 0, 0, 0, 0, // 0xe8
+    BLK_NEVER, BLK_NEVER, BLK_NEVER, BLK_NEVER, 0, BLK_WR1, 0, 0, // 0xf0
+    0, 0, 0, 0, 0, 0, 0, 0 // 0xf8
+};
+
+struct em8051decoded *decode_operation(struct em8051 *aCPU, uint16_t aAddress)
+{
+    struct em8051decoded *d = &aCPU->mDecoded[aAddress & aCPU->mCodeMemMaxIdx];
+    uint8_t opcode = CODEMEM(aAddress);
+    d->op = aCPU->mCore->op[opcode];
+    d->opcode = opcode;
+    d->operand[0] = CODEMEM(aAddress + 1);
+    d->operand[1] = CODEMEM(aAddress + 2);
+    d->length = op_length[opcode];
+    d->ticks = op_ticks[opcode];
+    d->block_ops = BLOCK_UNKNOWN;
+    return d;
+}
+
+// Reading the address may not be moved relative to timer ticks
+static bool block_read_ok(struct em8051 *aCPU, uint8_t aAddress)
+{
+    if (aAddress < 0x80)
+        return true;
+    if (aCPU->sfrread[aAddress - 0x80])
+        return false;
+    switch (aAddress - 0x80)
+    {
+    case REG_TL0:
+    case REG_TH0:
+    case REG_TL1:
+    case REG_TH1:
+        return false;
+    }
+    return true;
+}
+
+// Writing the address may not change timers, interrupts or power modes
+static bool block_write_ok(struct em8051 *aCPU, uint8_t aAddress)
+{
+    if (aAddress < 0x80)
+        return true;
+    if (aCPU->sfrwrite[aAddress - 0x80])
+        return false;
+    switch (aAddress - 0x80)
+    {
+    case REG_TCON:
+    case REG_TMOD:
+    case REG_TL0:
+    case REG_TH0:
+    case REG_TL1:
+    case REG_TH1:
+    case REG_SCON: // SM1 decides what timer 1 overflows do
+    case REG_IE:
+    case REG_IP:
+    case REG_PCON:
+        return false;
+    }
+    return true;
+}
+
+// Reading external memory goes through a callback that must see the timers
+// up to date; the address isn't known until the operation runs
+static bool block_xread_ok(struct em8051 *aCPU)
+{
+    int i;
+    if (aCPU->xread)
+        return false;
+    for (i = 0; i < 256; i++)
+        if (aCPU->xreadpage[i])
+            return false;
+    return true;
+}
+
+static bool block_operation(struct em8051 *aCPU, struct em8051decoded *aOp)
+{
+    uint8_t flags = op_block[aOp->opcode];
+    uint8_t bitbyte = bit_table[aOp->operand[0]].address;
+
+    if (flags & BLK_NEVER)
+        return false;
+    // mov a,acc raises an exception
+    if (aOp->opcode == 0xe5 && aOp->operand[0] == REG_ACC + 0x80)
+        return false;
+    if ((flags & BLK_XREAD) && !block_xread_ok(aCPU))
+        return false;
+    if ((flags & BLK_RD1) && !block_read_ok(aCPU, aOp->operand[0]))
+        return false;
+    if ((flags & BLK_WR1) && !block_write_ok(aCPU, aOp->operand[0]))
+        return false;
+    if ((flags & BLK_WR2) && !block_write_ok(aCPU, aOp->operand[1]))
+        return false;
+    if ((flags & BLK_BITRD) && !block_read_ok(aCPU, bitbyte))
+        return false;
+    if ((flags & BLK_BITWR) && !block_write_ok(aCPU, bitbyte))
+        return false;
+    return true;
+}
+
+// Recognizes busy-wait and delay loops of a single operation
+static uint8_t loop_kind(struct em8051 *aCPU, struct em8051decoded *aOp, uint16_t aAddress)
+{
+    uint8_t bitbyte = bit_table[aOp->operand[0]].address;
+
+    switch (aOp->opcode)
+    {
+    case 0x80: // sjmp
+        if (aOp->operand[0] == 0xfe)
+            return LOOP_SPIN;
+        break;
+    case 0x02: // ljmp
+        if (((aOp->operand[0] << 8) | aOp->operand[1]) == aAddress)
+            return LOOP_SPIN;
+        break;
+    case 0x20: // jb
+    case 0x30: // jnb
+        if (aOp->operand[1] == 0xfd && block_read_ok(aCPU, bitbyte))
+            return LOOP_WAIT;
+        break;
+    case 0xd5: // djnz iram
+        if (aOp->operand[1] == 0xfd && aOp->operand[0] < 0x80)
+            return LOOP_DELAY;
+        break;
+    default:
+        if ((aOp->opcode & 0x1f) == 0x01 && // ajmp
+            (((aAddress + 2) & 0xf800) | aOp->operand[0] | ((aOp->opcode & 0xe0) << 3)) == aAddress)
+            return LOOP_SPIN;
+        if ((aOp->opcode & 0xf8) == 0xd8 && aOp->operand[0] == 0xfe) // djnz Rn
+            return LOOP_DELAY;
+        break;
+    }
+    return LOOP_NONE;
+}
+
+uint32_t loop_count(struct em8051 *aCPU, struct em8051decoded *aOp)
+{
+    uint8_t address = aOp->operand[0];
+    uint8_t value;
+
+    switch (aOp->loop)
+    {
+    case LOOP_SPIN:
+        return LOOP_FOREVER;
+    case LOOP_WAIT:
+        // jb waits for the bit to clear, jnb for it to set
+        if (read_bit(aCPU, address) != (aOp->opcode == 0x20))
+            return 0;
+        return LOOP_FOREVER;
+    case LOOP_DELAY:
+        if (aOp->opcode == 0xd5)
+            value = aCPU->mLowerData[address];
+        else
+            value = aCPU->mLowerData[(aOp->opcode & 7) + BANK_OFFSET];
+        // the decrement to zero falls through
+        return (uint8_t)(value - 1);
+    }
+    return 0;
+}
+
+void loop_advance(struct em8051 *aCPU, struct em8051decoded *aOp, uint32_t aCount)
+{
+    // the others only spin
+    if (aOp->loop != LOOP_DELAY)
+        return;
+    if (aOp->opcode == 0xd5)
+        aCPU->mLowerData[aOp->operand[0]] -= (uint8_t)aCount;
+    else
+        aCPU->mLowerData[(aOp->opcode & 7) + BANK_OFFSET] -= (uint8_t)aCount;
+}
+
+void decode_block(struct em8051 *aCPU, uint16_t aAddress)
+{
+    struct em8051decoded *first = &aCPU->mDecoded[aAddress & aCPU->mCodeMemMaxIdx];
+    uint16_t pc = aAddress;
+    uint8_t ops = 0;
+    uint8_t ticks = 0;
+
+    while (ops < BLOCK_MAX_OPS)
+    {
+        struct em8051decoded *d = &aCPU->mDecoded[pc & aCPU->mCodeMemMaxIdx];
+        if (!d->op)
+            d = decode_operation(aCPU, pc);
+        if (!block_operation(aCPU, d))
+            break;
+        ops++;
+        ticks += d->ticks;
+        pc += d->length;
+        if (op_block[d->opcode] & BLK_CF)
+            break;
+    }
+
+    first->block_ops = ops;
+    first->block_ticks = ticks;
+    first->block_bytes = pc - aAddress;
+    first->loop = loop_kind(aCPU, first, aAddress);
+}
+
+#endif // !EM8051_CORE_VARIANT
+
+// Opcode handlers, by opcode
+const em8051operation CORE_NAME(op_table)[256] =
+{
+    &nop, &ajmp_offset, &ljmp_address, &rr_a, // 0x00
+    &inc_a, &inc_mem, &inc_indir_rx0, &inc_indir_rx1, // 0x04
+    &inc_rx0, &inc_rx1, &inc_rx2, &inc_rx3, // 0x08
+    &inc_rx4, &inc_rx5, &inc_rx6, &inc_rx7, // 0x0c
+    &jbc_bitaddr_offset, &acall_offset, &lcall_address, &rrc_a, // 0x10
+    &dec_a, &dec_mem, &dec_indir_rx0, &dec_indir_rx1, // 0x14
+    &dec_rx0, &dec_rx1, &dec_rx2, &dec_rx3, // 0x18
+    &dec_rx4, &dec_rx5, &dec_rx6, &dec_rx7, // 0x1c
+    &jb_bitaddr_offset, &ajmp_offset, &ret, &rl_a, // 0x20
+    &add_a_imm, &add_a_mem, &add_a_indir_rx0, &add_a_indir_rx1, // 0x24
+    &add_a_rx0, &add_a_rx1, &add_a_rx2, &add_a_rx3, // 0x28
+    &add_a_rx4, &add_a_rx5, &add_a_rx6, &add_a_rx7, // 0x2c
+    &jnb_bitaddr_offset, &acall_offset, &reti, &rlc_a, // 0x30
+    &addc_a_imm, &addc_a_mem, &addc_a_indir_rx0, &addc_a_indir_rx1, // 0x34
+    &addc_a_rx0, &addc_a_rx1, &addc_a_rx2, &addc_a_rx3, // 0x38
+    &addc_a_rx4, &addc_a_rx5, &addc_a_rx6, &addc_a_rx7, // 0x3c
+    &jc_offset, &ajmp_offset, &orl_mem_a, &orl_mem_imm, // 0x40
+    &orl_a_imm, &orl_a_mem, &orl_a_indir_rx0, &orl_a_indir_rx1, // 0x44
+    &orl_a_rx0, &orl_a_rx1, &orl_a_rx2, &orl_a_rx3, // 0x48
+    &orl_a_rx4, &orl_a_rx5, &orl_a_rx6, &orl_a_rx7, // 0x4c
+    &jnc_offset, &acall_offset, &anl_mem_a, &anl_mem_imm, // 0x50
+    &anl_a_imm, &anl_a_mem, &anl_a_indir_rx0, &anl_a_indir_rx1, // 0x54
+    &anl_a_rx0, &anl_a_rx1, &anl_a_rx2, &anl_a_rx3, // 0x58
+    &anl_a_rx4, &anl_a_rx5, &anl_a_rx6, &anl_a_rx7, // 0x5c
+    &jz_offset, &ajmp_offset, &xrl_mem_a, &xrl_mem_imm, // 0x60
+    &xrl_a_imm, &xrl_a_mem, &xrl_a_indir_rx0, &xrl_a_indir_rx1, // 0x64
+    &xrl_a_rx0, &xrl_a_rx1, &xrl_a_rx2, &xrl_a_rx3, // 0x68
+    &xrl_a_rx4, &xrl_a_rx5, &xrl_a_rx6, &xrl_a_rx7, // 0x6c
+    &jnz_offset, &acall_offset, &orl_c_bitaddr, &jmp_indir_a_dptr, // 0x70
+    &mov_a_imm, &mov_mem_imm, &mov_indir_rx_imm0, &mov_indir_rx_imm1, // 0x74
+    &mov_rx_imm0, &mov_rx_imm1, &mov_rx_imm2, &mov_rx_imm3, // 0x78
+    &mov_rx_imm4, &mov_rx_imm5, &mov_rx_imm6, &mov_rx_imm7, // 0x7c
+    &sjmp_offset, &ajmp_offset, &anl_c_bitaddr, &movc_a_indir_a_pc, // 0x80
+    &div_ab, &mov_mem_mem, &mov_mem_indir_rx0, &mov_mem_indir_rx1, // 0x84
+    &mov_mem_rx0, &mov_mem_rx1, &mov_mem_rx2, &mov_mem_rx3, // 0x88
+    &mov_mem_rx4, &mov_mem_rx5, &mov_mem_rx6, &mov_mem_rx7, // 0x8c
+    &mov_dptr_imm, &acall_offset, &mov_bitaddr_c, &movc_a_indir_a_dptr, // 0x90
+    &subb_a_imm, &subb_a_mem, &subb_a_indir_rx0, &subb_a_indir_rx1, // 0x94
+    &subb_a_rx0, &subb_a_rx1, &subb_a_rx2, &subb_a_rx3, // 0x98
+    &subb_a_rx4, &subb_a_rx5, &subb_a_rx6, &subb_a_rx7, // 0x9c
+    &orl_c_compl_bitaddr, &ajmp_offset, &mov_c_bitaddr, &inc_dptr, // 0xa0
+    &mul_ab, &nop, &mov_indir_rx_mem0, &mov_indir_rx_mem1, // 0xa4
+    &mov_rx_mem0, &mov_rx_mem1, &mov_rx_mem2, &mov_rx_mem3, // 0xa8
+    &mov_rx_mem4, &mov_rx_mem5, &mov_rx_mem6, &mov_rx_mem7, // 0xac
+    &anl_c_compl_bitaddr, &acall_offset, &cpl_bitaddr, &cpl_c, // 0xb0
+    &cjne_a_imm_offset, &cjne_a_mem_offset, &cjne_indir_rx_imm_offset0, &cjne_indir_rx_imm_offset1, // 0xb4
+    &cjne_rx_imm_offset0, &cjne_rx_imm_offset1, &cjne_rx_imm_offset2, &cjne_rx_imm_offset3, // 0xb8
+    &cjne_rx_imm_offset4, &cjne_rx_imm_offset5, &cjne_rx_imm_offset6, &cjne_rx_imm_offset7, // 0xbc
+    &push_mem, &ajmp_offset, &clr_bitaddr, &clr_c, // 0xc0
+    &swap_a, &xch_a_mem, &xch_a_indir_rx0, &xch_a_indir_rx1, // 0xc4
+    &xch_a_rx0, &xch_a_rx1, &xch_a_rx2, &xch_a_rx3, // 0xc8
+    &xch_a_rx4, &xch_a_rx5, &xch_a_rx6, &xch_a_rx7, // 0xcc
+    &pop_mem, &acall_offset, &setb_bitaddr, &setb_c, // 0xd0
+    &da_a, &djnz_mem_offset, &xchd_a_indir_rx0, &xchd_a_indir_rx1, // 0xd4
+    &djnz_rx_offset0, &djnz_rx_offset1, &djnz_rx_offset2, &djnz_rx_offset3, // 0xd8
+    &djnz_rx_offset4, &djnz_rx_offset5, &djnz_rx_offset6, &djnz_rx_offset7, // 0xdc
+    &movx_a_indir_dptr, &ajmp_offset, &movx_a_indir_rx0, &movx_a_indir_rx1, // 0xe0
+    &clr_a, &mov_a_mem, &mov_a_indir_rx0, &mov_a_indir_rx1, // 0xe4
+    &mov_a_rx0, &mov_a_rx1, &mov_a_rx2, &mov_a_rx3, // 0xe8
+    &mov_a_rx4, &mov_a_rx5, &mov_a_rx6, &mov_a_rx7, // 0xec
+    &movx_indir_dptr_a, &acall_offset, &movx_indir_rx_a0, &movx_indir_rx_a1, // 0xf0
+    &cpl_a, &mov_mem_a, &mov_indir_rx_a0, &mov_indir_rx_a1, // 0xf4
+    &mov_rx_a0, &mov_rx_a1, &mov_rx_a2, &mov_rx_a3, // 0xf8
+    &mov_rx_a4, &mov_rx_a5, &mov_rx_a6, &mov_rx_a7 // 0xfc
+};
+
+uint8_t CORE_NAME(do_op)(struct em8051 *aCPU)
 {
     switch (OPCODE)
     {
@@ -1813,17 +1957,17 @@ uint8_t do_op(struct em8051 *aCPU)
     case 0x03: return rr_a(aCPU);
     case 0x04: return inc_a(aCPU);
     case 0x05: return inc_mem(aCPU);
-    case 0x06: return inc_indir_rx(aCPU);
-    case 0x07: return inc_indir_rx(aCPU);
-
-    case 0x08:
-    case 0x09:
-    case 0x0a:
-    case 0x0b:
-    case 0x0c:
-    case 0x0d:
-    case 0x0e:
-    case 0x0f: return inc_rx(aCPU);
+    case 0x06: return inc_indir_rx0(aCPU);
+    case 0x07: return inc_indir_rx1(aCPU);
+
+    case 0x08: return inc_rx0(aCPU);
+    case 0x09: return inc_rx1(aCPU);
+    case 0x0a: return inc_rx2(aCPU);
+    case 0x0b: return inc_rx3(aCPU);
+    case 0x0c: return inc_rx4(aCPU);
+    case 0x0d: return inc_rx5(aCPU);
+    case 0x0e: return inc_rx6(aCPU);
+    case 0x0f: return inc_rx7(aCPU);
 
     case 0x10: return jbc_bitaddr_offset(aCPU);
     case 0x11: return acall_offset(aCPU);
@@ -1831,17 +1975,17 @@ uint8_t do_op(struct em8051 *aCPU)
     case 0x13: return rrc_a(aCPU);
     case 0x14: return dec_a(aCPU);
     case 0x15: return dec_mem(aCPU);
-    case 0x16: return dec_indir_rx(aCPU);
-    case 0x17: return dec_indir_rx(aCPU);
-
-    case 0x18:
-    case 0x19:
-    case 0x1a:
-    case 0x1b:
-    case 0x1c:
-    case 0x1d:
-    case 0x1e:
-    case 0x1f: return dec_rx(aCPU);
+    case 0x16: return dec_indir_rx0(aCPU);
+    case 0x17: return dec_indir_rx1(aCPU);
+
+    case 0x18: return dec_rx0(aCPU);
+    case 0x19: return dec_rx1(aCPU);
+    case 0x1a: return dec_rx2(aCPU);
+    case 0x1b: return dec_rx3(aCPU);
+    case 0x1c: return dec_rx4(aCPU);
+    case 0x1d: return dec_rx5(aCPU);
+    case 0x1e: return dec_rx6(aCPU);
+    case 0x1f: return dec_rx7(aCPU);
 
     case 0x20: return jb_bitaddr_offset(aCPU);
     case 0x21: return ajmp_offset(aCPU);
@@ -1849,17 +1993,17 @@ uint8_t do_op(struct em8051 *aCPU)
     case 0x23: return rl_a(aCPU);
     case 0x24: return add_a_imm(aCPU);
     case 0x25: return add_a_mem(aCPU);
-    case 0x26: return add_a_indir_rx(aCPU);
-    case 0x27: return add_a_indir_rx(aCPU);
-
-    case 0x28:
-    case 0x29:
-    case 0x2a:
-    case 0x2b:
-    case 0x2c:
-    case 0x2d:
-    case 0x2e:
-    case 0x2f: return add_a_rx(aCPU);
+    case 0x26: return add_a_indir_rx0(aCPU);
+    case 0x27: return add_a_indir_rx1(aCPU);
+
+    case 0x28: return add_a_rx0(aCPU);
+    case 0x29: return add_a_rx1(aCPU);
+    case 0x2a: return add_a_rx2(aCPU);
+    case 0x2b: return add_a_rx3(aCPU);
+    case 0x2c: return add_a_rx4(aCPU);
+    case 0x2d: return add_a_rx5(aCPU);
+    case 0x2e: return add_a_rx6(aCPU);
+    case 0x2f: return add_a_rx7(aCPU);
 
     case 0x30: return jnb_bitaddr_offset(aCPU);
     case 0x31: return acall_offset(aCPU);
@@ -1867,17 +2011,17 @@ uint8_t do_op(struct em8051 *aCPU)
     case 0x33: return rlc_a(aCPU);
     case 0x34: return addc_a_imm(aCPU);
     case 0x35: return addc_a_mem(aCPU);
-    case 0x36: return addc_a_indir_rx(aCPU);
-    case 0x37: return addc_a_indir_rx(aCPU);
-
-    case 0x38:
-    case 0x39:
-    case 0x3a:
-    case 0x3b:
-    case 0x3c:
-    case 0x3d:
-    case 0x3e:
-    case 0x3f: return addc_a_rx(aCPU);
+    case 0x36: return addc_a_indir_rx0(aCPU);
+    case 0x37: return addc_a_indir_rx1(aCPU);
+
+    case 0x38: return addc_a_rx0(aCPU);
+    case 0x39: return addc_a_rx1(aCPU);
+    case 0x3a: return addc_a_rx2(aCPU);
+    case 0x3b: return addc_a_rx3(aCPU);
+    case 0x3c: return addc_a_rx4(aCPU);
+    case 0x3d: return addc_a_rx5(aCPU);
+    case 0x3e: return addc_a_rx6(aCPU);
+    case 0x3f: return addc_a_rx7(aCPU);
 
     case 0x40: return jc_offset(aCPU);
     case 0x41: return ajmp_offset(aCPU);
@@ -1885,17 +2029,17 @@ uint8_t do_op(struct em8051 *aCPU)
     case 0x43: return orl_mem_imm(aCPU);
     case 0x44: return orl_a_imm(aCPU);
     case 0x45: return orl_a_mem(aCPU);
-    case 0x46: return orl_a_indir_rx(aCPU);
-    case 0x47: return orl_a_indir_rx(aCPU);
-
-    case 0x48:
-    case 0x49:
-    case 0x4a:
-    case 0x4b:
-    case 0x4c:
-    case 0x4d:
-    case 0x4e:
-    case 0x4f: return orl_a_rx(aCPU);
+    case 0x46: return orl_a_indir_rx0(aCPU);
+    case 0x47: return orl_a_indir_rx1(aCPU);
+
+    case 0x48: return orl_a_rx0(aCPU);
+    case 0x49: return orl_a_rx1(aCPU);
+    case 0x4a: return orl_a_rx2(aCPU);
+    case 0x4b: return orl_a_rx3(aCPU);
+    case 0x4c: return orl_a_rx4(aCPU);
+    case 0x4d: return orl_a_rx5(aCPU);
+    case 0x4e: return orl_a_rx6(aCPU);
+    case 0x4f: return orl_a_rx7(aCPU);
 
     case 0x50: return jnc_offset(aCPU);
     case 0x51: return acall_offset(aCPU);
@@ -1903,17 +2047,17 @@ uint8_t do_op(struct em8051 *aCPU)
     case 0x53: return anl_mem_imm(aCPU);
     case 0x54: return anl_a_imm(aCPU);
     case 0x55: return anl_a_mem(aCPU);
-    case 0x56: return anl_a_indir_rx(aCPU);
-    case 0x57: return anl_a_indir_rx(aCPU);
-
-    case 0x58:
-    case 0x59:
-    case 0x5a:
-    case 0x5b:
-    case 0x5c:
-    case 0x5d:
-    case 0x5e:
-    case 0x5f: return anl_a_rx(aCPU);
+    case 0x56: return anl_a_indir_rx0(aCPU);
+    case 0x57: return anl_a_indir_rx1(aCPU);
+
+    case 0x58: return anl_a_rx0(aCPU);
+    case 0x59: return anl_a_rx1(aCPU);
+    case 0x5a: return anl_a_rx2(aCPU);
+    case 0x5b: return anl_a_rx3(aCPU);
+    case 0x5c: return anl_a_rx4(aCPU);
+    case 0x5d: return anl_a_rx5(aCPU);
+    case 0x5e: return anl_a_rx6(aCPU);
+    case 0x5f: return anl_a_rx7(aCPU);
 
     case 0x60: return jz_offset(aCPU);
     case 0x61: return ajmp_offset(aCPU);
@@ -1921,17 +2065,17 @@ uint8_t do_op(struct em8051 *aCPU)
     case 0x63: return xrl_mem_imm(aCPU);
     case 0x64: return xrl_a_imm(aCPU);
     case 0x65: return xrl_a_mem(aCPU);
-    case 0x66: return xrl_a_indir_rx(aCPU);
-    case 0x67: return xrl_a_indir_rx(aCPU);
-
-    case 0x68:
-    case 0x69:
-    case 0x6a:
-    case 0x6b:
-    case 0x6c:
-    case 0x6d:
-    case 0x6e:
-    case 0x6f: return xrl_a_rx(aCPU);
+    case 0x66: return xrl_a_indir_rx0(aCPU);
+    case 0x67: return xrl_a_indir_rx1(aCPU);
+
+    case 0x68: return xrl_a_rx0(aCPU);
+    case 0x69: return xrl_a_rx1(aCPU);
+    case 0x6a: return xrl_a_rx2(aCPU);
+    case 0x6b: return xrl_a_rx3(aCPU);
+    case 0x6c: return xrl_a_rx4(aCPU);
+    case 0x6d: return xrl_a_rx5(aCPU);
+    case 0x6e: return xrl_a_rx6(aCPU);
+    case 0x6f: return xrl_a_rx7(aCPU);
 
     case 0x70: return jnz_offset(aCPU);
     case 0x71: return acall_offset(aCPU);
@@ -1939,17 +2083,17 @@ uint8_t do_op(struct em8051 *aCPU)
     case 0x73: return jmp_indir_a_dptr(aCPU);
     case 0x74: return mov_a_imm(aCPU);
     case 0x75: return mov_mem_imm(aCPU);
-    case 0x76: return mov_indir_rx_imm(aCPU);
-    case 0x77: return mov_indir_rx_imm(aCPU);
-
-    case 0x78:
-    case 0x79:
-    case 0x7a:
-    case 0x7b:
-    case 0x7c:
-    case 0x7d:
-    case 0x7e:
-    case 0x7f: return mov_rx_imm(aCPU);
+    case 0x76: return mov_indir_rx_imm0(aCPU);
+    case 0x77: return mov_indir_rx_imm1(aCPU);
+
+    case 0x78: return mov_rx_imm0(aCPU);
+    case 0x79: return mov_rx_imm1(aCPU);
+    case 0x7a: return mov_rx_imm2(aCPU);
+    case 0x7b: return mov_rx_imm3(aCPU);
+    case 0x7c: return mov_rx_imm4(aCPU);
+    case 0x7d: return mov_rx_imm5(aCPU);
+    case 0x7e: return mov_rx_imm6(aCPU);
+    case 0x7f: return mov_rx_imm7(aCPU);
 
     case 0x80: return sjmp_offset(aCPU);
     case 0x81: return ajmp_offset(aCPU);
@@ -1957,17 +2101,17 @@ uint8_t do_op(struct em8051 *aCPU)
     case 0x83: return movc_a_indir_a_pc(aCPU);
     case 0x84: return div_ab(aCPU);
     case 0x85: return mov_mem_mem(aCPU);
-    case 0x86: return mov_mem_indir_rx(aCPU);
-    case 0x87: return mov_mem_indir_rx(aCPU);
-
-    case 0x88:
-    case 0x89:
-    case 0x8a:
-    case 0x8b:
-    case 0x8c:
-    case 0x8d:
-    case 0x8e:
-    case 0x8f: return mov_mem_rx(aCPU);
+    case 0x86: return mov_mem_indir_rx0(aCPU);
+    case 0x87: return mov_mem_indir_rx1(aCPU);
+
+    case 0x88: return mov_mem_rx0(aCPU);
+    case 0x89: return mov_mem_rx1(aCPU);
+    case 0x8a: return mov_mem_rx2(aCPU);
+    case 0x8b: return mov_mem_rx3(aCPU);
+    case 0x8c: return mov_mem_rx4(aCPU);
+    case 0x8d: return mov_mem_rx5(aCPU);
+    case 0x8e: return mov_mem_rx6(aCPU);
+    case 0x8f: return mov_mem_rx7(aCPU);
 
     case 0x90: return mov_dptr_imm(aCPU);
     case 0x91: return acall_offset(aCPU);
@@ -1975,17 +2119,17 @@ uint8_t do_op(struct em8051 *aCPU)
     case 0x93: return movc_a_indir_a_dptr(aCPU);
     case 0x94: return subb_a_imm(aCPU);
     case 0x95: return subb_a_mem(aCPU);
-    case 0x96: return subb_a_indir_rx(aCPU);
-    case 0x97: return subb_a_indir_rx(aCPU);
-
-    case 0x98:
-    case 0x99:
-    case 0x9a:
-    case 0x9b:
-    case 0x9c:
-    case 0x9d:
-    case 0x9e:
-    case 0x9f: return subb_a_rx(aCPU);
+    case 0x96: return subb_a_indir_rx0(aCPU);
+    case 0x97: return subb_a_indir_rx1(aCPU);
+
+    case 0x98: return subb_a_rx0(aCPU);
+    case 0x99: return subb_a_rx1(aCPU);
+    case 0x9a: return subb_a_rx2(aCPU);
+    case 0x9b: return subb_a_rx3(aCPU);
+    case 0x9c: return subb_a_rx4(aCPU);
+    case 0x9d: return subb_a_rx5(aCPU);
+    case 0x9e: return subb_a_rx6(aCPU);
+    case 0x9f: return subb_a_rx7(aCPU);
 
     case 0xa0: return orl_c_compl_bitaddr(aCPU);
     case 0xa1: return ajmp_offset(aCPU);
@@ -1993,17 +2137,17 @@ uint8_t do_op(struct em8051 *aCPU)
     case 0xa3: return inc_dptr(aCPU);
     case 0xa4: return mul_ab(aCPU);
     case 0xa5: return nop(aCPU); // unused
-    case 0xa6: return mov_indir_rx_mem(aCPU);
-    case 0xa7: return mov_indir_rx_mem(aCPU);
-
-    case 0xa8:
-    case 0xa9:
-    case 0xaa:
-    case 0xab:
-    case 0xac:
-    case 0xad:
-    case 0xae:
-    case 0xaf: return mov_rx_mem(aCPU);
+    case 0xa6: return mov_indir_rx_mem0(aCPU);
+    case 0xa7: return mov_indir_rx_mem1(aCPU);
+
+    case 0xa8: return mov_rx_mem0(aCPU);
+    case 0xa9: return mov_rx_mem1(aCPU);
+    case 0xaa: return mov_rx_mem2(aCPU);
+    case 0xab: return mov_rx_mem3(aCPU);
+    case 0xac: return mov_rx_mem4(aCPU);
+    case 0xad: return mov_rx_mem5(aCPU);
+    case 0xae: return mov_rx_mem6(aCPU);
+    case 0xaf: return mov_rx_mem7(aCPU);
 
     case 0xb0: return anl_c_compl_bitaddr(aCPU);
     case 0xb1: return acall_offset(aCPU);
@@ -2011,17 +2155,17 @@ uint8_t do_op(struct em8051 *aCPU)
     case 0xb3: return cpl_c(aCPU);
     case 0xb4: return cjne_a_imm_offset(aCPU);
     case 0xb5: return cjne_a_mem_offset(aCPU);
-    case 0xb6: return cjne_indir_rx_imm_offset(aCPU);
-    case 0xb7: return cjne_indir_rx_imm_offset(aCPU);
-
-    case 0xb8:
-    case 0xb9:
-    case 0xba:
-    case 0xbb:
-    case 0xbc:
-    case 0xbd:
-    case 0xbe:
-    case 0xbf: return cjne_rx_imm_offset(aCPU);
+    case 0xb6: return cjne_indir_rx_imm_offset0(aCPU);
+    case 0xb7: return cjne_indir_rx_imm_offset1(aCPU);
+
+    case 0xb8: return cjne_rx_imm_offset0(aCPU);
+    case 0xb9: return cjne_rx_imm_offset1(aCPU);
+    case 0xba: return cjne_rx_imm_offset2(aCPU);
+    case 0xbb: return cjne_rx_imm_offset3(aCPU);
+    case 0xbc: return cjne_rx_imm_offset4(aCPU);
+    case 0xbd: return cjne_rx_imm_offset5(aCPU);
+    case 0xbe: return cjne_rx_imm_offset6(aCPU);
+    case 0xbf: return cjne_rx_imm_offset7(aCPU);
 
     case 0xc0: return push_mem(aCPU);
     case 0xc1: return ajmp_offset(aCPU);
@@ -2029,17 +2173,17 @@ uint8_t do_op(struct em8051 *aCPU)
     case 0xc3: return clr_c(aCPU);
     case 0xc4: return swap_a(aCPU);
     case 0xc5: return xch_a_mem(aCPU);
-    case 0xc6: return xch_a_indir_rx(aCPU);
-    case 0xc7: return xch_a_indir_rx(aCPU);
-
-    case 0xc8:
-    case 0xc9:
-    case 0xca:
-    case 0xcb:
-    case 0xcc:
-    case 0xcd:
-    case 0xce:
-    case 0xcf: return xch_a_rx(aCPU);
+    case 0xc6: return xch_a_indir_rx0(aCPU);
+    case 0xc7: return xch_a_indir_rx1(aCPU);
+
+    case 0xc8: return xch_a_rx0(aCPU);
+    case 0xc9: return xch_a_rx1(aCPU);
+    case 0xca: return xch_a_rx2(aCPU);
+    case 0xcb: return xch_a_rx3(aCPU);
+    case 0xcc: return xch_a_rx4(aCPU);
+    case 0xcd: return xch_a_rx5(aCPU);
+    case 0xce: return xch_a_rx6(aCPU);
+    case 0xcf: return xch_a_rx7(aCPU);
 
     case 0xd0: return pop_mem(aCPU);
     case 0xd1: return acall_offset(aCPU);
@@ -2047,54 +2191,432 @@ uint8_t do_op(struct em8051 *aCPU)
     case 0xd3: return setb_c(aCPU);
     case 0xd4: return da_a(aCPU);
     case 0xd5: return djnz_mem_offset(aCPU);
-    case 0xd6: return xchd_a_indir_rx(aCPU);
-    case 0xd7: return xchd_a_indir_rx(aCPU);
-
-    case 0xd8:
-    case 0xd9:
-    case 0xda:
-    case 0xdb:
-    case 0xdc:
-    case 0xdd:
-    case 0xde:
-    case 0xdf: return djnz_rx_offset(aCPU);
+    case 0xd6: return xchd_a_indir_rx0(aCPU);
+    case 0xd7: return xchd_a_indir_rx1(aCPU);
+
+    case 0xd8: return djnz_rx_offset0(aCPU);
+    case 0xd9: return djnz_rx_offset1(aCPU);
+    case 0xda: return djnz_rx_offset2(aCPU);
+    case 0xdb: return djnz_rx_offset3(aCPU);
+    case 0xdc: return djnz_rx_offset4(aCPU);
+    case 0xdd: return djnz_rx_offset5(aCPU);
+    case 0xde: return djnz_rx_offset6(aCPU);
+    case 0xdf: return djnz_rx_offset7(aCPU);
 
     case 0xe0: return movx_a_indir_dptr(aCPU);
     case 0xe1: return ajmp_offset(aCPU);
-    case 0xe2: return movx_a_indir_rx(aCPU);
-    case 0xe3: return movx_a_indir_rx(aCPU);
+    case 0xe2: return movx_a_indir_rx0(aCPU);
+    case 0xe3: return movx_a_indir_rx1(aCPU);
     case 0xe4: return clr_a(aCPU);
     case 0xe5: return mov_a_mem(aCPU);
-    case 0xe6: return mov_a_indir_rx(aCPU);
-    case 0xe7: return mov_a_indir_rx(aCPU);
-
-    case 0xe8:
-    case 0xe9:
-    case 0xea:
-    case 0xeb:
-    case 0xec:
-    case 0xed:
-    case 0xee:
-    case 0xef: return mov_a_rx(aCPU);
+    case 0xe6: return mov_a_indir_rx0(aCPU);
+    case 0xe7: return mov_a_indir_rx1(aCPU);
+
+    case 0xe8: return mov_a_rx0(aCPU);
+    case 0xe9: return mov_a_rx1(aCPU);
+    case 0xea: return mov_a_rx2(aCPU);
+    case 0xeb: return mov_a_rx3(aCPU);
+    case 0xec: return mov_a_rx4(aCPU);
+    case 0xed: return mov_a_rx5(aCPU);
+    case 0xee: return mov_a_rx6(aCPU);
+    case 0xef: return mov_a_rx7(aCPU);
 
     case 0xf0: return movx_indir_dptr_a(aCPU);
     case 0xf1: return acall_offset(aCPU);
-    case 0xf2: return movx_indir_rx_a(aCPU);
-    case 0xf3: return movx_indir_rx_a(aCPU);
+    case 0xf2: return movx_indir_rx_a0(aCPU);
+    case 0xf3: return movx_indir_rx_a1(aCPU);
     case 0xf4: return cpl_a(aCPU);
     case 0xf5: return mov_mem_a(aCPU);
-    case 0xf6: return mov_indir_rx_a(aCPU);
-    case 0xf7: return mov_indir_rx_a(aCPU);
-
-    case 0xf8:
-    case 0xf9:
-    case 0xfa:
-    case 0xfb:
-    case 0xfc:
-    case 0xfd:
-    case 0xfe:
-    case 0xff: return mov_rx_a(aCPU);
+    case 0xf6: return mov_indir_rx_a0(aCPU);
+    case 0xf7: return mov_indir_rx_a1(aCPU);
+
+    case 0xf8: return mov_rx_a0(aCPU);
+    case 0xf9: return mov_rx_a1(aCPU);
+    case 0xfa: return mov_rx_a2(aCPU);
+    case 0xfb: return mov_rx_a3(aCPU);
+    case 0xfc: return mov_rx_a4(aCPU);
+    case 0xfd: return mov_rx_a5(aCPU);
+    case 0xfe: return mov_rx_a6(aCPU);
+    case 0xff: return mov_rx_a7(aCPU);
    }
     return 0;
 }
 
+#ifdef EM8051_DISPATCH_THREADED
+
+// Bookkeeping between operations, as in tick() and run_cycles(). Returns
+// true if the next operation can be dispatched right away.
+static bool threaded_next(struct em8051 *aCPU, uint16_t aPC, uint32_t *aCycles, uint32_t aBudget)
+{
+    aCPU->mOperations++;
+    if (++aCPU->mCycles >= aCPU->mNextEvent)
+        timer_sync(aCPU);
+    (*aCycles)++;
+    if (aCPU->trace)
+    {
+        timer_sync(aCPU);
+        update_flags(aCPU);
+        update_parity(aCPU);
+        aCPU->trace(aCPU, aPC, aCPU->mTickDelay ? aCPU->mTickDelay : 1);
+    }
+    if (aCPU->mException != -1 || aCPU->mPC == aCPU->mBreakpoint)
+        return false;
+
+    // rest of a multi-tick operation
+    while (aCPU->mTickDelay > 1)
+    {
+        if (*aCycles >= aBudget)
+            return false;
+        aCPU->mTickDelay--;
+        if (++aCPU->mCycles >= aCPU->mNextEvent)
+            timer_sync(aCPU);
+        (*aCycles)++;
+    }
+
+    if (*aCycles >= aBudget || (aCPU->mSFR[REG_PCON] & 0x03))
+        return false;
+
+    aCPU->mTickDelay = 0;
+    handle_interrupts(aCPU);
+    if (aCPU->mTickDelay)
+    {
+        // interrupt call
+        if (++aCPU->mCycles >= aCPU->mNextEvent)
+            timer_sync(aCPU);
+        (*aCycles)++;
+        return false;
+    }
+    return true;
+}
+
+// Each handler ends in its own indirect jump, so the branch predictor
+// sees which operation tends to follow which
+#define THREADED_OP(handler) \
+    pc = PC; \
+    aCPU->mTickDelay = handler(aCPU); \
+    if (!threaded_next(aCPU, pc, &cycles, aBudget)) \
+        return cycles; \
+    goto *dispatch[OPCODE]
+
+uint32_t CORE_NAME(run_threaded)(struct em8051 *aCPU, uint32_t aBudget)
+{
+    static const void *dispatch[256] =
+    {
+        &&op_00, &&op_01, &&op_02, &&op_03, &&op_04, &&op_05, &&op_06, &&op_07,
+        &&op_08, &&op_09, &&op_0a, &&op_0b, &&op_0c, &&op_0d, &&op_0e, &&op_0f,
+        &&op_10, &&op_11, &&op_12, &&op_13, &&op_14, &&op_15, &&op_16, &&op_17,
+        &&op_18, &&op_19, &&op_1a, &&op_1b, &&op_1c, &&op_1d, &&op_1e, &&op_1f,
+        &&op_20, &&op_21, &&op_22, &&op_23, &&op_24, &&op_25, &&op_26, &&op_27,
+        &&op_28, &&op_29, &&op_2a, &&op_2b, &&op_2c, &&op_2d, &&op_2e, &&op_2f,
+        &&op_30, &&op_31, &&op_32, &&op_33, &&op_34, &&op_35, &&op_36, &&op_37,
+        &&op_38, &&op_39, &&op_3a, &&op_3b, &&op_3c, &&op_3d, &&op_3e, &&op_3f,
+        &&op_40, &&op_41, &&op_42, &&op_43, &&op_44, &&op_45, &&op_46, &&op_47,
+        &&op_48, &&op_49, &&op_4a, &&op_4b, &&op_4c, &&op_4d, &&op_4e, &&op_4f,
+        &&op_50, &&op_51, &&op_52, &&op_53, &&op_54, &&op_55, &&op_56, &&op_57,
+        &&op_58, &&op_59, &&op_5a, &&op_5b, &&op_5c, &&op_5d, &&op_5e, &&op_5f,
+        &&op_60, &&op_61, &&op_62, &&op_63, &&op_64, &&op_65, &&op_66, &&op_67,
+        &&op_68, &&op_69, &&op_6a, &&op_6b, &&op_6c, &&op_6d, &&op_6e, &&op_6f,
+        &&op_70, &&op_71, &&op_72, &&op_73, &&op_74, &&op_75, &&op_76, &&op_77,
+        &&op_78, &&op_79, &&op_7a, &&op_7b, &&op_7c, &&op_7d, &&op_7e, &&op_7f,
+        &&op_80, &&op_81, &&op_82, &&op_83, &&op_84, &&op_85, &&op_86, &&op_87,
+        &&op_88, &&op_89, &&op_8a, &&op_8b, &&op_8c, &&op_8d, &&op_8e, &&op_8f,
+        &&op_90, &&op_91, &&op_92, &&op_93, &&op_94, &&op_95, &&op_96, &&op_97,
+        &&op_98, &&op_99, &&op_9a, &&op_9b, &&op_9c, &&op_9d, &&op_9e, &&op_9f,
+        &&op_a0, &&op_a1, &&op_a2, &&op_a3, &&op_a4, &&op_a5, &&op_a6, &&op_a7,
+        &&op_a8, &&op_a9, &&op_aa, &&op_ab, &&op_ac, &&op_ad, &&op_ae, &&op_af,
+        &&op_b0, &&op_b1, &&op_b2, &&op_b3, &&op_b4, &&op_b5, &&op_b6, &&op_b7,
+        &&op_b8, &&op_b9, &&op_ba, &&op_bb, &&op_bc, &&op_bd, &&op_be, &&op_bf,
+        &&op_c0, &&op_c1, &&op_c2, &&op_c3, &&op_c4, &&op_c5, &&op_c6, &&op_c7,
+        &&op_c8, &&op_c9, &&op_ca, &&op_cb, &&op_cc, &&op_cd, &&op_ce, &&op_cf,
+        &&op_d0, &&op_d1, &&op_d2, &&op_d3, &&op_d4, &&op_d5, &&op_d6, &&op_d7,
+        &&op_d8, &&op_d9, &&op_da, &&op_db, &&op_dc, &&op_dd, &&op_de, &&op_df,
+        &&op_e0, &&op_e1, &&op_e2, &&op_e3, &&op_e4, &&op_e5, &&op_e6, &&op_e7,
+        &&op_e8, &&op_e9, &&op_ea, &&op_eb, &&op_ec, &&op_ed, &&op_ee, &&op_ef,
+        &&op_f0, &&op_f1, &&op_f2, &&op_f3, &&op_f4, &&op_f5, &&op_f6, &&op_f7,
+        &&op_f8, &&op_f9, &&op_fa, &&op_fb, &&op_fc, &&op_fd, &&op_fe, &&op_ff,
+    };
+    uint32_t cycles = 0;
+    uint16_t pc;
+
+    aCPU->mTickDelay = 0;
+    handle_interrupts(aCPU);
+    if (aCPU->mTickDelay)
+    {
+        // interrupt call
+        if (++aCPU->mCycles >= aCPU->mNextEvent)
+            timer_sync(aCPU);
+        return 1;
+    }
+    goto *dispatch[OPCODE];
+
+op_00: THREADED_OP(nop);
+op_01: THREADED_OP(ajmp_offset);
+op_02: THREADED_OP(ljmp_address);
+op_03: THREADED_OP(rr_a);
+op_04: THREADED_OP(inc_a);
+op_05: THREADED_OP(inc_mem);
+op_06: THREADED_OP(inc_indir_rx0);
+op_07: THREADED_OP(inc_indir_rx1);
+op_08: THREADED_OP(inc_rx0);
+op_09: THREADED_OP(inc_rx1);
+op_0a: THREADED_OP(inc_rx2);
+op_0b: THREADED_OP(inc_rx3);
+op_0c: THREADED_OP(inc_rx4);
+op_0d: THREADED_OP(inc_rx5);
+op_0e: THREADED_OP(inc_rx6);
+op_0f: THREADED_OP(inc_rx7);
+op_10: THREADED_OP(jbc_bitaddr_offset);
+op_11: THREADED_OP(acall_offset);
+op_12: THREADED_OP(lcall_address);
+op_13: THREADED_OP(rrc_a);
+op_14: THREADED_OP(dec_a);
+op_15: THREADED_OP(dec_mem);
+op_16: THREADED_OP(dec_indir_rx0);
+op_17: THREADED_OP(dec_indir_rx1);
+op_18: THREADED_OP(dec_rx0);
+op_19: THREADED_OP(dec_rx1);
+op_1a: THREADED_OP(dec_rx2);
+op_1b: THREADED_OP(dec_rx3);
+op_1c: THREADED_OP(dec_rx4);
+op_1d: THREADED_OP(dec_rx5);
+op_1e: THREADED_OP(dec_rx6);
+op_1f: THREADED_OP(dec_rx7);
+op_20: THREADED_OP(jb_bitaddr_offset);
+op_21: THREADED_OP(ajmp_offset);
+op_22: THREADED_OP(ret);
+op_23: THREADED_OP(rl_a);
+op_24: THREADED_OP(add_a_imm);
+op_25: THREADED_OP(add_a_mem);
+op_26: THREADED_OP(add_a_indir_rx0);
+op_27: THREADED_OP(add_a_indir_rx1);
+op_28: THREADED_OP(add_a_rx0);
+op_29: THREADED_OP(add_a_rx1);
+op_2a: THREADED_OP(add_a_rx2);
+op_2b: THREADED_OP(add_a_rx3);
+op_2c: THREADED_OP(add_a_rx4);
+op_2d: THREADED_OP(add_a_rx5);
+op_2e: THREADED_OP(add_a_rx6);
+op_2f: THREADED_OP(add_a_rx7);
+op_30: THREADED_OP(jnb_bitaddr_offset);
+op_31: THREADED_OP(acall_offset);
+op_32: THREADED_OP(reti);
+op_33: THREADED_OP(rlc_a);
+op_34: THREADED_OP(addc_a_imm);
+op_35: THREADED_OP(addc_a_mem);
+op_36: THREADED_OP(addc_a_indir_rx0);
+op_37: THREADED_OP(addc_a_indir_rx1);
+op_38: THREADED_OP(addc_a_rx0);
+op_39: THREADED_OP(addc_a_rx1);
+op_3a: THREADED_OP(addc_a_rx2);
+op_3b: THREADED_OP(addc_a_rx3);
+op_3c: THREADED_OP(addc_a_rx4);
+op_3d: THREADED_OP(addc_a_rx5);
+op_3e: THREADED_OP(addc_a_rx6);
+op_3f: THREADED_OP(addc_a_rx7);
+op_40: THREADED_OP(jc_offset);
+op_41: THREADED_OP(ajmp_offset);
+op_42: THREADED_OP(orl_mem_a);
+op_43: THREADED_OP(orl_mem_imm);
+op_44: THREADED_OP(orl_a_imm);
+op_45: THREADED_OP(orl_a_mem);
+op_46: THREADED_OP(orl_a_indir_rx0);
+op_47: THREADED_OP(orl_a_indir_rx1);
+op_48: THREADED_OP(orl_a_rx0);
+op_49: THREADED_OP(orl_a_rx1);
+op_4a: THREADED_OP(orl_a_rx2);
+op_4b: THREADED_OP(orl_a_rx3);
+op_4c: THREADED_OP(orl_a_rx4);
+op_4d: THREADED_OP(orl_a_rx5);
+op_4e: THREADED_OP(orl_a_rx6);
+op_4f: THREADED_OP(orl_a_rx7);
+op_50: THREADED_OP(jnc_offset);
+op_51: THREADED_OP(acall_offset);
+op_52: THREADED_OP(anl_mem_a);
+op_53: THREADED_OP(anl_mem_imm);
+op_54: THREADED_OP(anl_a_imm);
+op_55: THREADED_OP(anl_a_mem);
+op_56: THREADED_OP(anl_a_indir_rx0);
+op_57: THREADED_OP(anl_a_indir_rx1);
+op_58: THREADED_OP(anl_a_rx0);
+op_59: THREADED_OP(anl_a_rx1);
+op_5a: THREADED_OP(anl_a_rx2);
+op_5b: THREADED_OP(anl_a_rx3);
+op_5c: THREADED_OP(anl_a_rx4);
+op_5d: THREADED_OP(anl_a_rx5);
+op_5e: THREADED_OP(anl_a_rx6);
+op_5f: THREADED_OP(anl_a_rx7);
+op_60: THREADED_OP(jz_offset);
+op_61: THREADED_OP(ajmp_offset);
+op_62: THREADED_OP(xrl_mem_a);
+op_63: THREADED_OP(xrl_mem_imm);
+op_64: THREADED_OP(xrl_a_imm);
+op_65: THREADED_OP(xrl_a_mem);
+op_66: THREADED_OP(xrl_a_indir_rx0);
+op_67: THREADED_OP(xrl_a_indir_rx1);
+op_68: THREADED_OP(xrl_a_rx0);
+op_69: THREADED_OP(xrl_a_rx1);
+op_6a: THREADED_OP(xrl_a_rx2);
+op_6b: THREADED_OP(xrl_a_rx3);
+op_6c: THREADED_OP(xrl_a_rx4);
+op_6d: THREADED_OP(xrl_a_rx5);
+op_6e: THREADED_OP(xrl_a_rx6);
+op_6f: THREADED_OP(xrl_a_rx7);
+op_70: THREADED_OP(jnz_offset);
+op_71: THREADED_OP(acall_offset);
+op_72: THREADED_OP(orl_c_bitaddr);
+op_73: THREADED_OP(jmp_indir_a_dptr);
+op_74: THREADED_OP(mov_a_imm);
+op_75: THREADED_OP(mov_mem_imm);
+op_76: THREADED_OP(mov_indir_rx_imm0);
+op_77: THREADED_OP(mov_indir_rx_imm1);
+op_78: THREADED_OP(mov_rx_imm0);
+op_79: THREADED_OP(mov_rx_imm1);
+op_7a: THREADED_OP(mov_rx_imm2);
+op_7b: THREADED_OP(mov_rx_imm3);
+op_7c: THREADED_OP(mov_rx_imm4);
+op_7d: THREADED_OP(mov_rx_imm5);
+op_7e: THREADED_OP(mov_rx_imm6);
+op_7f: THREADED_OP(mov_rx_imm7);
+op_80: THREADED_OP(sjmp_offset);
+op_81: THREADED_OP(ajmp_offset);
+op_82: THREADED_OP(anl_c_bitaddr);
+op_83: THREADED_OP(movc_a_indir_a_pc);
+op_84: THREADED_OP(div_ab);
+op_85: THREADED_OP(mov_mem_mem);
+op_86: THREADED_OP(mov_mem_indir_rx0);
+op_87: THREADED_OP(mov_mem_indir_rx1);
+op_88: THREADED_OP(mov_mem_rx0);
+op_89: THREADED_OP(mov_mem_rx1);
+op_8a: THREADED_OP(mov_mem_rx2);
+op_8b: THREADED_OP(mov_mem_rx3);
+op_8c: THREADED_OP(mov_mem_rx4);
+op_8d: THREADED_OP(mov_mem_rx5);
+op_8e: THREADED_OP(mov_mem_rx6);
+op_8f: THREADED_OP(mov_mem_rx7);
+op_90: THREADED_OP(mov_dptr_imm);
+op_91: THREADED_OP(acall_offset);
+op_92: THREADED_OP(mov_bitaddr_c);
+op_93: THREADED_OP(movc_a_indir_a_dptr);
+op_94: THREADED_OP(subb_a_imm);
+op_95: THREADED_OP(subb_a_mem);
+op_96: THREADED_OP(subb_a_indir_rx0);
+op_97: THREADED_OP(subb_a_indir_rx1);
+op_98: THREADED_OP(subb_a_rx0);
+op_99: THREADED_OP(subb_a_rx1);
+op_9a: THREADED_OP(subb_a_rx2);
+op_9b: THREADED_OP(subb_a_rx3);
+op_9c: THREADED_OP(subb_a_rx4);
+op_9d: THREADED_OP(subb_a_rx5);
+op_9e: THREADED_OP(subb_a_rx6);
+op_9f: THREADED_OP(subb_a_rx7);
+op_a0: THREADED_OP(orl_c_compl_bitaddr);
+op_a1: THREADED_OP(ajmp_offset);
+op_a2: THREADED_OP(mov_c_bitaddr);
+op_a3: THREADED_OP(inc_dptr);
+op_a4: THREADED_OP(mul_ab);
+op_a5: THREADED_OP(nop);
+op_a6: THREADED_OP(mov_indir_rx_mem0);
+op_a7: THREADED_OP(mov_indir_rx_mem1);
+op_a8: THREADED_OP(mov_rx_mem0);
+op_a9: THREADED_OP(mov_rx_mem1);
+op_aa: THREADED_OP(mov_rx_mem2);
+op_ab: THREADED_OP(mov_rx_mem3);
+op_ac: THREADED_OP(mov_rx_mem4);
+op_ad: THREADED_OP(mov_rx_mem5);
+op_ae: THREADED_OP(mov_rx_mem6);
+op_af: THREADED_OP(mov_rx_mem7);
+op_b0: THREADED_OP(anl_c_compl_bitaddr);
+op_b1: THREADED_OP(acall_offset);
+op_b2: THREADED_OP(cpl_bitaddr);
+op_b3: THREADED_OP(cpl_c);
+op_b4: THREADED_OP(cjne_a_imm_offset);
+op_b5: THREADED_OP(cjne_a_mem_offset);
+op_b6: THREADED_OP(cjne_indir_rx_imm_offset0);
+op_b7: THREADED_OP(cjne_indir_rx_imm_offset1);
+op_b8: THREADED_OP(cjne_rx_imm_offset0);
+op_b9: THREADED_OP(cjne_rx_imm_offset1);
+op_ba: THREADED_OP(cjne_rx_imm_offset2);
+op_bb: THREADED_OP(cjne_rx_imm_offset3);
+op_bc: THREADED_OP(cjne_rx_imm_offset4);
+op_bd: THREADED_OP(cjne_rx_imm_offset5);
+op_be: THREADED_OP(cjne_rx_imm_offset6);
+op_bf: THREADED_OP(cjne_rx_imm_offset7);
+op_c0: THREADED_OP(push_mem);
+op_c1: THREADED_OP(ajmp_offset);
+op_c2: THREADED_OP(clr_bitaddr);
+op_c3: THREADED_OP(clr_c);
+op_c4: THREADED_OP(swap_a);
+op_c5: THREADED_OP(xch_a_mem);
+op_c6: THREADED_OP(xch_a_indir_rx0);
+op_c7: THREADED_OP(xch_a_indir_rx1);
+op_c8: THREADED_OP(xch_a_rx0);
+op_c9: THREADED_OP(xch_a_rx1);
+op_ca: THREADED_OP(xch_a_rx2);
+op_cb: THREADED_OP(xch_a_rx3);
+op_cc: THREADED_OP(xch_a_rx4);
+op_cd: THREADED_OP(xch_a_rx5);
+op_ce: THREADED_OP(xch_a_rx6);
+op_cf: THREADED_OP(xch_a_rx7);
+op_d0: THREADED_OP(pop_mem);
+op_d1: THREADED_OP(acall_offset);
+op_d2: THREADED_OP(setb_bitaddr);
+op_d3: THREADED_OP(setb_c);
+op_d4: THREADED_OP(da_a);
+op_d5: THREADED_OP(djnz_mem_offset);
+op_d6: THREADED_OP(xchd_a_indir_rx0);
+op_d7: THREADED_OP(xchd_a_indir_rx1);
+op_d8: THREADED_OP(djnz_rx_offset0);
+op_d9: THREADED_OP(djnz_rx_offset1);
+op_da: THREADED_OP(djnz_rx_offset2);
+op_db: THREADED_OP(djnz_rx_offset3);
+op_dc: THREADED_OP(djnz_rx_offset4);
+op_dd: THREADED_OP(djnz_rx_offset5);
+op_de: THREADED_OP(djnz_rx_offset6);
+op_df: THREADED_OP(djnz_rx_offset7);
+op_e0: THREADED_OP(movx_a_indir_dptr);
+op_e1: THREADED_OP(ajmp_offset);
+op_e2: THREADED_OP(movx_a_indir_rx0);
+op_e3: THREADED_OP(movx_a_indir_rx1);
+op_e4: THREADED_OP(clr_a);
+op_e5: THREADED_OP(mov_a_mem);
+op_e6: THREADED_OP(mov_a_indir_rx0);
+op_e7: THREADED_OP(mov_a_indir_rx1);
+op_e8: THREADED_OP(mov_a_rx0);
+op_e9: THREADED_OP(mov_a_rx1);
+op_ea: THREADED_OP(mov_a_rx2);
+op_eb: THREADED_OP(mov_a_rx3);
+op_ec: THREADED_OP(mov_a_rx4);
+op_ed: THREADED_OP(mov_a_rx5);
+op_ee: THREADED_OP(mov_a_rx6);
+op_ef: THREADED_OP(mov_a_rx7);
+op_f0: THREADED_OP(movx_indir_dptr_a);
+op_f1: THREADED_OP(acall_offset);
+op_f2: THREADED_OP(movx_indir_rx_a0);
+op_f3: THREADED_OP(movx_indir_rx_a1);
+op_f4: THREADED_OP(cpl_a);
+op_f5: THREADED_OP(mov_mem_a);
+op_f6: THREADED_OP(mov_indir_rx_a0);
+op_f7: THREADED_OP(mov_indir_rx_a1);
+op_f8: THREADED_OP(mov_rx_a0);
+op_f9: THREADED_OP(mov_rx_a1);
+op_fa: THREADED_OP(mov_rx_a2);
+op_fb: THREADED_OP(mov_rx_a3);
+op_fc: THREADED_OP(mov_rx_a4);
+op_fd: THREADED_OP(mov_rx_a5);
+op_fe: THREADED_OP(mov_rx_a6);
+op_ff: THREADED_OP(mov_rx_a7);
+}
+
+#endif // EM8051_DISPATCH_THREADED
+
+const struct em8051core CORE_NAME(core_ops) =
+{
+    CORE_NAME(op_table),
+    CORE_NAME(do_op),
+#ifdef EM8051_DISPATCH_THREADED
+    CORE_NAME(run_threaded),
+#else
+    NULL,
+#endif
+};
+
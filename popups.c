@@ -130,6 +130,8 @@ void emu_exception(struct em8051 *aCPU, int aCode)
                                      break;
     case EXCEPTION_ILLEGAL_OPCODE: waddstr(exc,"Invalid opcode: 0xA5 encountered"); 
                                    break;
+    case EXCEPTION_JIT_MISMATCH: waddstr(exc,"JIT: native code differs from interpreter");
+                                 break;
     default:
         waddstr(exc,"Unknown exception"); 
     }
@@ -197,6 +199,7 @@ void emu_load(struct em8051 *aCPU)
     }
 
     result = load_obj(aCPU, filename);
+    checkpoints_clear(&checkpoints, aCPU);
     delwin(exc);
     refreshview(aCPU);
 
@@ -427,7 +430,7 @@ void emu_help(struct em8051 *aCPU)
 
     runmode = 0;
     setSpeed(speed, runmode);
-    exc = subwin(stdscr, 14, 70, (LINES-14)/2, (COLS-70)/2);
+    exc = subwin(stdscr, 15, 70, (LINES-15)/2, (COLS-70)/2);
     wattron(exc,A_REVERSE);
     werase(exc);
     box(exc,ACS_VLINE,ACS_HLINE);
@@ -439,7 +442,7 @@ void emu_help(struct em8051 *aCPU)
     waddstr(exc, "8051 Emulator v. 0.72 - http://iki.fi/sol/");
     wmove(exc, 3, 2);
     waddstr(exc, "Copyright (c) 2006 Jari Komppa");
-    wmove(exc, 13, 22);
+    wmove(exc, 14, 22);
     wattron(exc,A_REVERSE);
     waddstr(exc, "Press any key to continue");
     wattroff(exc,A_REVERSE);
@@ -452,6 +455,7 @@ void emu_help(struct em8051 *aCPU)
     mvwaddstr(exc, 9, 2, "+ & - - Adjust run speed");
     mvwaddstr(exc, 10, 6, "v - Change views");
     mvwaddstr(exc, 11, 3, "home - Reset (with options)");
+    mvwaddstr(exc, 12, 6, "u - Step back");
 
     mvwaddstr(exc, 5, 32, "shift-q - Quit");
     mvwaddstr(exc, 6, 32, "cursors - Move cursor");
@@ -460,6 +464,7 @@ void emu_help(struct em8051 *aCPU)
     mvwaddstr(exc, 9, 36, "end - Reset tick/time counter");
     mvwaddstr(exc, 10, 38, "k - Set or clear breakpoint");
     mvwaddstr(exc, 11, 38, "g - Go to address (adjust PC)");
+    mvwaddstr(exc, 12, 32, "shift-u - Back to breakpoint");
 
     wrefresh(exc);
 
@@ -0,0 +1,390 @@
+/* 8051 emulator core
+ * Copyright 2006 Jari Komppa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining 
+ * a copy of this software and associated documentation files (the 
+ * "Software"), to deal in the Software without restriction, including 
+ * without limitation the rights to use, copy, modify, merge, publish, 
+ * distribute, sublicense, and/or sell copies of the Software, and to 
+ * permit persons to whom the Software is furnished to do so, subject 
+ * to the following conditions: 
+ *
+ * The above copyright notice and this permission notice shall be included 
+ * in all copies or substantial portions of the Software. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+ * IN THE SOFTWARE. 
+ *
+ * (i.e. the MIT License)
+ *
+ * runner.c
+ * Runs batches of programs on separate emulator instances across all
+ * processor cores
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "emu8051.h"
+
+// Memory configurations a job can ask for
+struct config
+{
+    const char *name;
+    uint16_t code_max; // mCodeMemMaxIdx
+    uint16_t xdata_max; // mExtDataMaxIdx
+    bool xdata; // has external data memory
+    bool upper; // has upper 128 bytes of internal RAM
+};
+
+static const struct config configs[] =
+{
+    { "8052", 0xffff, 0xffff, true, true },
+    { "8051", 0x0fff, 0xffff, true, false },
+    { "2051", 0x07ff, 0, false, false }
+};
+
+struct job
+{
+    char hexfile[256];
+    const struct config *config;
+    uint32_t budget; // ticks to run
+
+    // results
+    bool nomem; // the instance couldn't be allocated
+    int load; // load_obj() result
+    int stop; // EM8051_STOP
+    int exception; // exception code, or -1
+    uint32_t ticks;
+    uint16_t pc;
+    uint8_t acc;
+    uint32_t iram; // checksum of internal RAM and SFRs
+};
+
+// Job indices [head, tail) left for one worker. The worker takes jobs from
+// the head; idle workers steal from the tail.
+struct queue
+{
+    pthread_mutex_t lock;
+    int head;
+    int tail;
+};
+
+struct pool
+{
+    struct job *jobs;
+    struct queue *queues;
+    int workers;
+};
+
+struct worker
+{
+    struct pool *pool;
+    int index;
+};
+
+static void runner_exception(struct em8051 *aCPU, int aCode)
+{
+    // run_cycles() stops and reports the code; nothing else to do
+}
+
+// FNV-1a over internal RAM and SFRs, for comparing results between runs
+static uint32_t checksum(struct em8051 *aCPU)
+{
+    uint32_t hash = 2166136261u;
+    int i;
+    for (i = 0; i < 128; i++)
+        hash = (hash ^ aCPU->mLowerData[i]) * 16777619u;
+    if (aCPU->mUpperData)
+        for (i = 0; i < 128; i++)
+            hash = (hash ^ aCPU->mUpperData[i]) * 16777619u;
+    for (i = 0; i < 128; i++)
+        hash = (hash ^ aCPU->mSFR[i]) * 16777619u;
+    return hash;
+}
+
+static void run_job(struct job *aJob)
+{
+    struct em8051 *emu = calloc(1, sizeof(struct em8051));
+    const struct config *config = aJob->config;
+    uint32_t left = aJob->budget;
+
+    aJob->nomem = !emu;
+    if (!emu)
+        return;
+    emu->mCodeMemMaxIdx = config->code_max;
+    emu->mCodeMem = calloc(config->code_max + 1, sizeof(unsigned char));
+    emu->mExtDataMaxIdx = config->xdata_max;
+    emu->mExtData = config->xdata ? calloc(config->xdata_max + 1, sizeof(unsigned char)) : NULL;
+    emu->mUpperData = config->upper ? calloc(128, sizeof(unsigned char)) : NULL;
+    emu->except = &runner_exception;
+    emu->mBreakpoint = -1;
+
+    if (!emu->mCodeMem || (config->xdata && !emu->mExtData) || (config->upper && !emu->mUpperData))
+    {
+        aJob->nomem = true;
+    }
+    else
+    {
+        reset(emu, 1);
+        decode_cache(emu, 1);
+
+        aJob->ticks = 0;
+        aJob->stop = STOP_BUDGET;
+        aJob->load = load_obj(emu, aJob->hexfile);
+        if (aJob->load == 0)
+        {
+            while (left > 0)
+            {
+                uint32_t ticks = run_cycles(emu, left, &aJob->stop);
+                aJob->ticks += ticks;
+                left -= ticks;
+                if (aJob->stop != STOP_BUDGET)
+                    break;
+            }
+        }
+        aJob->exception = emu->mException;
+        aJob->pc = emu->mPC;
+        aJob->acc = emu->mSFR[REG_ACC];
+        aJob->iram = checksum(emu);
+    }
+
+    decode_cache(emu, 0);
+    free(emu->mCodeMem);
+    free(emu->mExtData);
+    free(emu->mUpperData);
+    free(emu);
+}
+
+// Next job from the worker's own queue, or one stolen from another
+// worker's; -1 when all are taken
+static int next_job(struct pool *aPool, int aWorker)
+{
+    int i;
+    for (i = 0; i < aPool->workers; i++)
+    {
+        struct queue *queue = &aPool->queues[(aWorker + i) % aPool->workers];
+        int job = -1;
+        pthread_mutex_lock(&queue->lock);
+        if (queue->head < queue->tail)
+        {
+            if (i == 0)
+                job = queue->head++;
+            else
+                job = --queue->tail;
+        }
+        pthread_mutex_unlock(&queue->lock);
+        if (job >= 0)
+            return job;
+    }
+    return -1;
+}
+
+static void *worker_main(void *aWorker)
+{
+    struct worker *worker = aWorker;
+    int job;
+    while ((job = next_job(worker->pool, worker->index)) >= 0)
+        run_job(&worker->pool->jobs[job]);
+    return NULL;
+}
+
+static const struct config *find_config(const char *aName)
+{
+    unsigned int i;
+    for (i = 0; i < sizeof(configs) / sizeof(configs[0]); i++)
+        if (strcmp(configs[i].name, aName) == 0)
+            return &configs[i];
+    return NULL;
+}
+
+// Job file: one job per line, "hexfile config ticks"; # starts a comment
+static int read_jobs(FILE *aFile, struct job **aJobs)
+{
+    char line[512];
+    int count = 0;
+    int size = 0;
+    int lineno = 0;
+
+    *aJobs = NULL;
+    while (fgets(line, sizeof(line), aFile))
+    {
+        char hexfile[256], config[16];
+        unsigned long budget;
+        struct job *job;
+
+        lineno++;
+        if (line[strspn(line, " \t\r\n")] == 0 || line[strspn(line, " \t")] == '#')
+            continue;
+        if (sscanf(line, "%255s %15s %lu", hexfile, config, &budget) != 3 || !find_config(config))
+        {
+            fprintf(stderr, "Line %d: expected \"hexfile 8052|8051|2051 ticks\"\n", lineno);
+            return -1;
+        }
+        if (count == size)
+        {
+            struct job *jobs;
+            size = size ? size * 2 : 64;
+            jobs = realloc(*aJobs, size * sizeof(struct job));
+            if (!jobs)
+            {
+                fprintf(stderr, "Out of memory\n");
+                return -1;
+            }
+            *aJobs = jobs;
+        }
+        job = &(*aJobs)[count++];
+        memset(job, 0, sizeof(struct job));
+        strcpy(job->hexfile, hexfile);
+        job->config = find_config(config);
+        job->budget = budget;
+    }
+    return count;
+}
+
+static const char *stop_name(int aStop)
+{
+    switch (aStop)
+    {
+    case STOP_BREAKPOINT: return "breakpoint";
+    case STOP_EXCEPTION: return "exception";
+    }
+    return "budget";
+}
+
+int main(int parc, char ** pars)
+{
+    struct pool pool;
+    struct worker *workers;
+    pthread_t *threads;
+    struct timespec start, end;
+    const char *filename = NULL;
+    FILE *f = stdin;
+    double seconds;
+    uint64_t total = 0;
+    int failed = 0;
+    int started;
+    int threadcount = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int count;
+    int i;
+
+    for (i = 1; i < parc; i++)
+    {
+        if (strcmp(pars[i], "-j") == 0 && i + 1 < parc)
+        {
+            threadcount = atoi(pars[++i]);
+        }
+        else
+        if (pars[i][0] == '-' && pars[i][1] != 0)
+        {
+            printf("Usage: emu-runner [-j threads] [jobfile]\n\n"
+                "Runs each job of the job file (or standard input) on its own emulator\n"
+                "instance, on as many threads as there are processors by default.\n"
+                "A job is a line \"hexfile config ticks\", config being 8052, 8051 or 2051.\n"
+                "Exit code is 1 if any job couldn't be loaded or stopped on an exception.\n");
+            return -1;
+        }
+        else
+        {
+            filename = pars[i];
+        }
+    }
+    if (threadcount < 1)
+        threadcount = 1;
+
+    if (filename && strcmp(filename, "-") != 0)
+    {
+        f = fopen(filename, "r");
+        if (!f)
+        {
+            printf("File '%s' not found\n", filename);
+            return -1;
+        }
+    }
+    count = read_jobs(f, &pool.jobs);
+    if (f != stdin)
+        fclose(f);
+    if (count < 0)
+        return -1;
+    if (threadcount > count)
+        threadcount = count > 0 ? count : 1;
+
+    // hand out the jobs in even runs; stealing evens out the rest
+    pool.workers = threadcount;
+    pool.queues = calloc(threadcount, sizeof(struct queue));
+    workers = calloc(threadcount, sizeof(struct worker));
+    threads = calloc(threadcount, sizeof(pthread_t));
+    if (!pool.queues || !workers || !threads)
+    {
+        printf("Out of memory\n");
+        return -1;
+    }
+    for (i = 0; i < threadcount; i++)
+    {
+        pthread_mutex_init(&pool.queues[i].lock, NULL);
+        pool.queues[i].head = (int)((int64_t)count * i / threadcount);
+        pool.queues[i].tail = (int)((int64_t)count * (i + 1) / threadcount);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < threadcount; i++)
+    {
+        workers[i].pool = &pool;
+        workers[i].index = i;
+        if (pthread_create(&threads[i], NULL, worker_main, &workers[i]) != 0)
+            break;
+    }
+    // if threads couldn't be started, this one steals their jobs
+    started = i;
+    if (started < threadcount)
+        worker_main(&workers[started]);
+    for (i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    for (i = 0; i < count; i++)
+    {
+        struct job *job = &pool.jobs[i];
+        if (job->nomem)
+        {
+            printf("%d %s %s out of memory\n", i, job->hexfile, job->config->name);
+            failed = 1;
+            continue;
+        }
+        if (job->load != 0)
+        {
+            failed = 1;
+            printf("%d %s %s load failure %d\n", i, job->hexfile, job->config->name, job->load);
+            continue;
+        }
+        printf("%d %s %s %s", i, job->hexfile, job->config->name, stop_name(job->stop));
+        if (job->stop == STOP_EXCEPTION)
+        {
+            printf(" %d", job->exception);
+            failed = 1;
+        }
+        printf(" ticks=%u pc=%04x a=%02x iram=%08x\n", job->ticks, job->pc, job->acc, job->iram);
+        total += job->ticks;
+    }
+
+    seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%d jobs on %d threads: %llu ticks in %.3f s, %.0f ticks/s (%.2f MHz)\n",
+        count, threadcount, (unsigned long long)total, seconds,
+        seconds > 0 ? total / seconds : 0, seconds > 0 ? total * 12 / seconds / 1e6 : 0);
+
+    for (i = 0; i < threadcount; i++)
+        pthread_mutex_destroy(&pool.queues[i].lock);
+    free(pool.queues);
+    free(pool.jobs);
+    free(workers);
+    free(threads);
+    return failed;
+}
@@ -0,0 +1,185 @@
+/* 8051 emulator core
+ * Copyright 2006 Jari Komppa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining 
+ * a copy of this software and associated documentation files (the 
+ * "Software"), to deal in the Software without restriction, including 
+ * without limitation the rights to use, copy, modify, merge, publish, 
+ * distribute, sublicense, and/or sell copies of the Software, and to 
+ * permit persons to whom the Software is furnished to do so, subject 
+ * to the following conditions: 
+ *
+ * The above copyright notice and this permission notice shall be included 
+ * in all copies or substantial portions of the Software. 
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER 
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING 
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS 
+ * IN THE SOFTWARE. 
+ *
+ * (i.e. the MIT License)
+ *
+ * snapshot.c
+ * Saving, restoring and forking emulator state
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "emu8051.h"
+
+// State kept in struct em8051 outside the memories: everything in front of
+// mCodeMem, and the interrupt and serial bookkeeping from int_a to the end
+#define STATE_FRONT offsetof(struct em8051, mCodeMem)
+#define STATE_BACK offsetof(struct em8051, int_a)
+
+static void copy_state(struct em8051 *aTo, const struct em8051 *aFrom)
+{
+    memcpy(aTo, aFrom, STATE_FRONT);
+    memcpy((char *)aTo + STATE_BACK, (const char *)aFrom + STATE_BACK, sizeof(struct em8051) - STATE_BACK);
+}
+
+// The dirty marks of the instance are relative to this snapshot
+static bool is_baseline(struct em8051 *aCPU, const struct em8051snapshot *aSnapshot)
+{
+    return aSnapshot->mSource == aCPU && aSnapshot->mSerial == aCPU->mXBaseline;
+}
+
+struct em8051snapshot *em8051_snapshot(struct em8051 *aCPU)
+{
+    struct em8051snapshot *snapshot = calloc(1, sizeof(struct em8051snapshot));
+    uint32_t xdata_size = aCPU->mExtDataMaxIdx + 1;
+
+    if (!snapshot)
+        return NULL;
+    if (aCPU->mExtData)
+    {
+        snapshot->mExtData = malloc(xdata_size);
+        if (!snapshot->mExtData)
+        {
+            free(snapshot);
+            return NULL;
+        }
+        memcpy(snapshot->mExtData, aCPU->mExtData, xdata_size);
+    }
+
+    // registers the core only brings up to date when looked at
+    timer_sync(aCPU);
+    update_flags(aCPU);
+    update_parity(aCPU);
+
+    // the new baseline; 0 stands for none
+    if (++aCPU->mXSerial == 0)
+        aCPU->mXSerial = 1;
+    aCPU->mXBaseline = aCPU->mXSerial;
+    memset(aCPU->mXDirty, 0, sizeof(aCPU->mXDirty));
+    snapshot->mState = *aCPU;
+    snapshot->mSource = aCPU;
+    snapshot->mSerial = aCPU->mXSerial;
+    if (aCPU->mUpperData)
+        memcpy(snapshot->mUpperData, aCPU->mUpperData, 128);
+    // code memory only changes through aliased external memory; otherwise
+    // forks share the original
+    snapshot->mCodeAliased = aCPU->mExtData != NULL && aCPU->mExtData == aCPU->mCodeMem;
+    return snapshot;
+}
+
+void em8051_restore(struct em8051 *aCPU, const struct em8051snapshot *aSnapshot)
+{
+    copy_state(aCPU, &aSnapshot->mState);
+    if (aCPU->mExtData && aSnapshot->mExtData)
+        memcpy(aCPU->mExtData, aSnapshot->mExtData, aCPU->mExtDataMaxIdx + 1);
+    if (aCPU->mUpperData)
+        memcpy(aCPU->mUpperData, aSnapshot->mUpperData, 128);
+    if (aSnapshot->mCodeAliased)
+        invalidate_code(aCPU, 0, aCPU->mCodeMemMaxIdx + 1);
+    memset(aCPU->mXDirty, 0, sizeof(aCPU->mXDirty));
+    aCPU->mXBaseline = aSnapshot->mSource == aCPU ? aSnapshot->mSerial : 0;
+}
+
+void em8051_restore_dirty(struct em8051 *aCPU, const struct em8051snapshot *aSnapshot)
+{
+    uint32_t pages = (aCPU->mExtDataMaxIdx >> 8) + 1;
+    uint32_t page;
+
+    // pages written before a later snapshot or restore aren't marked
+    if (!is_baseline(aCPU, aSnapshot))
+    {
+        em8051_restore(aCPU, aSnapshot);
+        return;
+    }
+
+    copy_state(aCPU, &aSnapshot->mState);
+    if (aCPU->mUpperData)
+        memcpy(aCPU->mUpperData, aSnapshot->mUpperData, 128);
+    if (!aCPU->mExtData || !aSnapshot->mExtData)
+        return;
+    for (page = 0; page < pages; page++)
+    {
+        uint32_t address = page << 8;
+        uint32_t length = aCPU->mExtDataMaxIdx + 1 - address < 256 ? aCPU->mExtDataMaxIdx + 1 - address : 256;
+        if (!aCPU->mXDirty[page])
+            continue;
+        aCPU->mXDirty[page] = 0;
+        memcpy(aCPU->mExtData + address, aSnapshot->mExtData + address, length);
+        if (aSnapshot->mCodeAliased)
+            invalidate_code(aCPU, address, length);
+    }
+}
+
+bool em8051_fork(struct em8051 *aChild, const struct em8051snapshot *aSnapshot)
+{
+    const struct em8051 *parent = &aSnapshot->mState;
+    uint32_t xdata_size = parent->mExtDataMaxIdx + 1;
+
+    *aChild = *parent;
+    aChild->mExtData = NULL;
+    aChild->mUpperData = NULL;
+    // no decode cache or JIT: decoding fills the cache in as the code runs,
+    // so sharing the original's would race with it on other threads
+    aChild->mDecoded = NULL;
+    aChild->mJit = NULL;
+    aChild->mCheckpoints = NULL;
+    aChild->mXBaseline = 0;
+
+    // 64k is copied faster than a copy-on-write mapping of it is set up
+    if (aSnapshot->mExtData)
+    {
+        aChild->mExtData = malloc(xdata_size);
+        if (!aChild->mExtData)
+            return false;
+        memcpy(aChild->mExtData, aSnapshot->mExtData, xdata_size);
+        if (aSnapshot->mCodeAliased)
+            aChild->mCodeMem = aChild->mExtData;
+    }
+    if (parent->mUpperData)
+    {
+        aChild->mUpperData = malloc(128);
+        if (!aChild->mUpperData)
+        {
+            free(aChild->mExtData);
+            aChild->mExtData = NULL;
+            return false;
+        }
+        memcpy(aChild->mUpperData, aSnapshot->mUpperData, 128);
+    }
+    return true;
+}
+
+void em8051_fork_free(struct em8051 *aChild)
+{
+    decode_cache(aChild, false);
+    free(aChild->mExtData);
+    free(aChild->mUpperData);
+    aChild->mExtData = NULL;
+    aChild->mUpperData = NULL;
+}
+
+void em8051_snapshot_free(struct em8051snapshot *aSnapshot)
+{
+    free(aSnapshot->mExtData);
+    free(aSnapshot);
+}